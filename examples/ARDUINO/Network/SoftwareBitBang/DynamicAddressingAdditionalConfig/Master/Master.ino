@@ -114,7 +114,7 @@ void loop() {
   if(millis() - t_millis > 5000) {
     Serial.println("Updated list of known slaves: ");
     for(uint8_t i = 0; i < OSPREY_MAX_SLAVES; i++) {
-      if(master.ids[i].state != OSPREY_INDEX_ASSIGNED) continue;
+      if(master.get_state(i + 1) != OSPREY_INDEX_ASSIGNED) continue;
       Serial.print("Device id: ");
       Serial.print(i + 1);
       Serial.print(" mac: ");
@@ -0,0 +1,42 @@
+/* OSPREYThreadedMaster example
+   The master's receive, update and addressing run on a dedicated thread,
+   the application reads the packets received and the slaves found from a
+   queue and its slow work does not delay the bus.
+
+   Compile from this directory (PJON_PATH points to PJON's src directory):
+   make PJON_PATH=../../../../../../PJON/src */
+
+#include <PJONLocalUDP.h>
+#include <runtime/OSPREYThreadedMaster.h>
+#include <stdio.h>
+#include <unistd.h>
+
+OSPREYMaster<
+  LocalUDP,
+  OSPREY_MAX_SLAVES,
+  OSPREY_CONFIGURATION_LENGTH,
+  OSPREYQueueHandlers<>
+> master;
+
+OSPREYThreadedMaster<decltype(master)> runtime(master);
+
+int main() {
+  printf("OSPREYThreadedMaster example started.\n");
+  runtime.start();
+  while(true) {
+    for(OSPREY_Event *e = runtime.receive(); e; e = runtime.receive()) {
+      if(e->type == OSPREY_EVENT_FOUND_SLAVE) {
+        printf("Slave found, id %d.\n", e->info.tx.id);
+        runtime.send(e->info.tx.id, e->info.tx.bus_id, "Hi!", 3);
+      }
+      if(e->type == OSPREY_EVENT_PACKET)
+        printf("Received %d bytes from %d.\n", e->length, e->info.tx.id);
+      if(e->type == OSPREY_EVENT_ERROR)
+        printf("Error %d, data %d.\n", e->code, e->data);
+      runtime.release();
+    }
+    // Slow application work
+    usleep(100000);
+  }
+  return 0;
+}
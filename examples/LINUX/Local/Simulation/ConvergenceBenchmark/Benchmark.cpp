@@ -0,0 +1,186 @@
+
+/* OSPREY addressing convergence benchmark
+   One OSPREYMaster and N OSPREYSlave instances are connected to a simulated
+   medium using virtual time, the benchmark reports:
+   - Time required by all slaves to acquire an id
+   - Frames transmitted for each successful join
+   - OSPREY_ID_NEGATE requests received by slaves
+   - Time required to recover after a master restart
+
+   Compile from this directory (PJON_PATH points to PJON's src directory):
+   make PJON_PATH=../../../../../../PJON/src
+
+   Usage:
+   ./Benchmark -n 200 -l 0 -b 100 -p 0.01 -c 50 -s 1
+
+   -n slaves count             -l frame latency (microseconds)
+   -b byte time (microseconds) -p frame loss probability
+   -c collision window (us)    -t simulation step (microseconds)
+   -s random seed              -m maximum simulated time (seconds)
+   -w restart the master restoring its devices buffer (warm restart) */
+
+#ifndef OSPREY_MAX_SLAVES
+  #define OSPREY_MAX_SLAVES 253
+#endif
+
+// The recovery after a master restart lists the ids with the known bitmap
+#ifndef OSPREY_ID_LIST_ROSTER
+  #define OSPREY_ID_LIST_ROSTER true
+#endif
+
+#include "SimulatedBus.h"
+#include <OSPREYMaster.h>
+#include <OSPREYSlave.h>
+#include <stdio.h>
+#include <unistd.h>
+
+class MemoryStorage : public OSPREYStorage {
+  public:
+    bool read(uint16_t address, uint8_t *data, uint16_t length) {
+      if(((uint32_t)address + length) > sizeof(_data)) return false;
+      memcpy(data, _data + address, length);
+      return true;
+    };
+
+    bool write(uint16_t address, const uint8_t *data, uint16_t length) {
+      if(((uint32_t)address + length) > sizeof(_data)) return false;
+      memcpy(_data + address, data, length);
+      return true;
+    };
+
+  private:
+    uint8_t _data[4096];
+};
+
+typedef OSPREYMaster<SimulatedBus> Master;
+typedef OSPREYSlave<SimulatedBus> Slave;
+
+SimulatedMedium medium;
+MemoryStorage storage;
+Master *master;
+Slave *slaves[OSPREY_MAX_SLAVES];
+uint16_t slaves_count = 100;
+uint32_t step = 100;
+uint32_t max_time = 600;
+uint32_t negates = 0;
+
+uint16_t receive_master(void *device) {
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_slave(void *device) {
+  return ((Slave *)device)->receive();
+};
+
+void master_receiver(uint8_t *, uint16_t, const PJON_Packet_Info &) { };
+
+void master_error(uint8_t, uint16_t, void *) { };
+
+void slave_receiver(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &info
+) {
+  if(
+    length && (info.port == OSPREY_DYNAMIC_ADDRESSING_PORT) &&
+    (payload[0] == OSPREY_ID_NEGATE)
+  ) negates++;
+};
+
+void slave_error(uint8_t, uint16_t, void *) { };
+
+uint16_t count_connected() {
+  uint16_t result = 0;
+  for(uint16_t i = 0; i < slaves_count; i++)
+    if(slaves[i]->addressing_state() == OSPREY_SLAVE_CONNECTED) result++;
+  return result;
+};
+
+/* Run the simulation until all slaves are connected and known by master,
+   returns the simulated time elapsed in microseconds or 0 on timeout: */
+
+uint32_t converge() {
+  uint32_t start = PJON_MICROS();
+  while((uint32_t)(PJON_MICROS() - start) < (max_time * 1000000)) {
+    SimulatedClock::micros() += step;
+    master->update();
+    for(uint16_t i = 0; i < slaves_count; i++) slaves[i]->update();
+    if(
+      (master->count_slaves() == slaves_count) &&
+      (count_connected() == slaves_count)
+    ) return PJON_MICROS() - start;
+  }
+  return 0;
+};
+
+void report(const char *name, uint32_t time, uint32_t frames, uint32_t n) {
+  if(!time) printf("%s: not converged in %lu s\n", name, (unsigned long)max_time);
+  else printf("%s: %.3f s\n", name, time / 1000000.0);
+  printf("  frames: %lu (%.2f per slave)\n", (unsigned long)frames, (double)frames / n);
+  printf("  negates: %lu, collisions: %lu, lost: %lu\n",
+    (unsigned long)negates,
+    (unsigned long)medium.collisions,
+    (unsigned long)medium.lost
+  );
+};
+
+int main(int argc, char **argv) {
+  bool warm = false;
+  int option;
+  while((option = getopt(argc, argv, "n:l:b:p:c:t:s:m:w")) != -1) {
+    if(option == 'n') slaves_count = atoi(optarg);
+    else if(option == 'l') medium.latency = atol(optarg);
+    else if(option == 'b') medium.byte_time = atol(optarg);
+    else if(option == 'p') medium.loss = atof(optarg);
+    else if(option == 'c') medium.collision = atol(optarg);
+    else if(option == 't') step = atol(optarg);
+    else if(option == 's') SimulatedClock::seed() = atol(optarg) | 1;
+    else if(option == 'm') max_time = atol(optarg);
+    else if(option == 'w') warm = true;
+    else return 1;
+  }
+  if(!slaves_count || (slaves_count > OSPREY_MAX_SLAVES)) {
+    printf("Slaves count must be between 1 and %d\n", OSPREY_MAX_SLAVES);
+    return 1;
+  }
+
+  master = new Master();
+  master->strategy.set_medium(&medium, master, receive_master);
+  master->set_receiver(master_receiver);
+  master->set_error(master_error);
+  if(warm) master->set_storage(&storage);
+  master->begin();
+
+  for(uint16_t i = 0; i < slaves_count; i++) {
+    uint8_t mac[6] = {
+      (uint8_t)PJON_RANDOM(256), (uint8_t)PJON_RANDOM(256),
+      (uint8_t)PJON_RANDOM(256), (uint8_t)PJON_RANDOM(256),
+      (uint8_t)(i >> 8), (uint8_t)i
+    };
+    slaves[i] = new Slave(mac);
+    slaves[i]->strategy.set_medium(&medium, slaves[i], receive_slave);
+    slaves[i]->set_receiver(slave_receiver);
+    slaves[i]->set_error(slave_error);
+    slaves[i]->begin();
+    slaves[i]->request_id();
+  }
+
+  printf("OSPREY convergence benchmark, %u slaves\n", slaves_count);
+  uint32_t time = converge();
+  report("Convergence", time, medium.frames, slaves_count);
+  if(!time) return 1;
+
+  // Let the slaves leave the OSPREY_ID_LIST response guard time
+  SimulatedClock::micros() += OSPREY_ADDRESSING_TIMEOUT * 2;
+  uint32_t frames = medium.frames;
+  negates = medium.collisions = medium.lost = 0;
+  master->begin();
+  time = converge();
+  report(
+    warm ? "Recovery (warm restart)" : "Recovery",
+    time,
+    medium.frames - frames,
+    slaves_count
+  );
+  return time ? 0 : 1;
+};
@@ -0,0 +1,231 @@
+
+/* SimulatedBus is an in-memory PJON strategy used to run one OSPREYMaster
+   and many OSPREYSlave instances in the same process. Time is virtual,
+   PJON_MICROS returns the simulation clock which is advanced by the
+   simulation loop, so the results do not depend on the host's speed.
+
+   Frames are delivered synchronously to all the other devices, so the
+   acknowledgement is available as soon as the frame is transmitted.
+   The medium model is configurable:
+   - latency:    fixed time added to each frame (microseconds)
+   - byte_time:  transmission time of each byte (microseconds)
+   - loss:       probability of a frame to be lost (0.0 - 1.0)
+   - collision:  time after the start of a frame during which other devices
+                 cannot detect it, a frame started within this window
+                 collides and is lost (the first transmitter captures the
+                 medium) */
+
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+
+// Virtual clock
+
+struct SimulatedClock {
+  static uint32_t &micros() {
+    static uint32_t time = 0;
+    return time;
+  };
+  static uint32_t &seed() {
+    static uint32_t s = 1;
+    return s;
+  };
+  static uint32_t random(uint32_t max) {
+    // xorshift32, deterministic for a given seed
+    uint32_t &x = seed();
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return max ? (x % max) : 0;
+  };
+};
+
+#define PJON_MICROS() SimulatedClock::micros()
+#define PJON_MILLIS() (SimulatedClock::micros() / 1000)
+#define PJON_DELAY(x) (SimulatedClock::micros() += ((uint32_t)(x) * 1000))
+#define PJON_DELAY_MICROSECONDS(x) (SimulatedClock::micros() += (x))
+#define PJON_RANDOM(x) SimulatedClock::random(x)
+
+#define PJON_INCLUDE_NONE
+#define PJON_INCLUDE_MAC
+#define PJON_INCLUDE_PORT
+#include <PJON.h>
+
+#ifndef SIMULATED_BUS_MAX_DEVICES
+  #define SIMULATED_BUS_MAX_DEVICES 256
+#endif
+
+#ifndef SIMULATED_BUS_MAX_ATTEMPTS
+  #define SIMULATED_BUS_MAX_ATTEMPTS 10
+#endif
+
+typedef uint16_t (* SimulatedBus_Receive)(void *device);
+
+struct SimulatedMedium {
+  uint32_t latency = 0;
+  uint32_t byte_time = 100;
+  float    loss = 0;
+  uint32_t collision = 50;
+
+  // Statistics
+  uint32_t frames = 0;
+  uint32_t bytes = 0;
+  uint32_t lost = 0;
+  uint32_t collisions = 0;
+
+  struct Frame {
+    uint8_t  data[PJON_PACKET_MAX_LENGTH];
+    uint16_t length;
+  };
+
+  struct Device {
+    void                *device;
+    SimulatedBus_Receive receive;
+    const Frame         *frame;
+  };
+
+  /* Attach a device, receive is called to let it process a frame: */
+
+  uint16_t attach(void *device, SimulatedBus_Receive receive) {
+    if(_count >= SIMULATED_BUS_MAX_DEVICES) return PJON_FAIL;
+    _devices[_count].device = device;
+    _devices[_count].receive = receive;
+    _devices[_count].frame = NULL;
+    return _count++;
+  };
+
+  /* Check if a device can start transmitting: */
+
+  bool can_start(uint16_t node) const {
+    uint32_t now = PJON_MICROS();
+    if((int32_t)(now - _busy_until) >= 0) return true;
+    // Another device started too recently to be detected
+    return (node != _last_node) && ((uint32_t)(now - _last_start) < collision);
+  };
+
+  /* Transmit a frame and let each other device receive it: */
+
+  void transmit(uint16_t node, const uint8_t *data, uint16_t length) {
+    uint32_t now = PJON_MICROS();
+    bool collided = (int32_t)(now - _busy_until) < 0;
+    uint32_t end = now + latency + (length * byte_time);
+    if(!collided || ((int32_t)(end - _busy_until) > 0)) _busy_until = end;
+    _last_start = now;
+    _last_node = node;
+    _response = PJON_FAIL;
+    frames++;
+    bytes += length;
+    if(collided) {
+      collisions++;
+      return;
+    }
+    if((loss > 0) && (SimulatedClock::random(1000000) < (loss * 1000000))) {
+      lost++;
+      return;
+    }
+    memcpy(_frame.data, data, length);
+    _frame.length = length;
+    for(uint16_t i = 0; i < _count; i++) {
+      if(i == node) continue;
+      _devices[i].frame = &_frame;
+      _devices[i].receive(_devices[i].device);
+      _devices[i].frame = NULL;
+    }
+  };
+
+  /* Frame currently delivered to a device: */
+
+  uint16_t receive(uint16_t node, uint8_t *data, uint16_t max_length) {
+    if((node >= _count) || !_devices[node].frame) return PJON_FAIL;
+    const Frame *f = _devices[node].frame;
+    _devices[node].frame = NULL; // Each frame is received once
+    uint16_t length = (f->length < max_length) ? f->length : max_length;
+    memcpy(data, f->data, length);
+    return length;
+  };
+
+  /* Response transmitted by the receiver of the last frame: */
+
+  void respond(uint8_t response) {
+    _response = response;
+  };
+
+  uint16_t response() {
+    uint16_t r = _response;
+    _response = PJON_FAIL;
+    return r;
+  };
+
+  private:
+    Device   _devices[SIMULATED_BUS_MAX_DEVICES];
+    uint16_t _count = 0;
+    Frame    _frame;
+    uint32_t _busy_until = 0;
+    uint32_t _last_start = 0;
+    uint16_t _last_node = PJON_FAIL;
+    uint16_t _response = PJON_FAIL;
+};
+
+/* PJON strategy connected to a SimulatedMedium:
+   bus.strategy.set_medium(&medium, device, receive_function); */
+
+class SimulatedBus {
+  public:
+    /* Connect to a medium, receive is called with device as parameter each
+       time a frame is transmitted by another device: */
+
+    void set_medium(
+      SimulatedMedium *medium,
+      void *device,
+      SimulatedBus_Receive receive
+    ) {
+      _medium = medium;
+      _node = medium->attach(device, receive);
+    };
+
+    static uint32_t back_off(uint8_t attempts) {
+      uint32_t result = attempts;
+      for(uint8_t d = 0; d < 3; d++) result *= (uint32_t)(attempts);
+      return 1000 + (result * 1000) + SimulatedClock::random(1000);
+    };
+
+    bool begin(uint8_t = 0) {
+      return _medium != NULL;
+    };
+
+    bool can_start() {
+      return _medium && _medium->can_start(_node);
+    };
+
+    static uint8_t get_max_attempts() {
+      return SIMULATED_BUS_MAX_ATTEMPTS;
+    };
+
+    static uint16_t get_receive_time() {
+      return 0;
+    };
+
+    void handle_collision() { };
+
+    uint16_t receive_frame(uint8_t *data, uint16_t max_length) {
+      if(!_medium) return PJON_FAIL;
+      return _medium->receive(_node, data, max_length);
+    };
+
+    uint16_t receive_response() {
+      if(!_medium) return PJON_FAIL;
+      return _medium->response();
+    };
+
+    void send_frame(uint8_t *data, uint16_t length) {
+      if(_medium) _medium->transmit(_node, data, length);
+    };
+
+    void send_response(uint8_t response) {
+      if(_medium) _medium->respond(response);
+    };
+
+  private:
+    SimulatedMedium *_medium = NULL;
+    uint16_t         _node = PJON_FAIL;
+};
@@ -0,0 +1,105 @@
+/* Expiry of the reserved ids: the devices buffer frees them in the order of
+   their registration, an id reserved again moves to the end of the queue
+   and a confirmed id leaves it. A master frees the id reserved to a slave
+   that does not receive the response after OSPREY_ADDRESSING_TIMEOUT. */
+
+#include "Test.h"
+#include <OSPREYMaster.h>
+#include <OSPREYSlave.h>
+
+typedef OSPREYMaster<SimulatedBus, 8> Master;
+typedef OSPREYSlave<SimulatedBus> Slave;
+
+SimulatedMedium medium;
+bool slave_deaf = false;
+
+uint16_t receive_master(void *device) {
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_slave(void *device) {
+  if(slave_deaf) return PJON_FAIL;
+  return ((Slave *)device)->receive();
+};
+
+void no_error(uint8_t, uint16_t, void *) { };
+
+void test_queue() {
+  OSPREYRoster<8> roster;
+  uint8_t a[6] = {1, 2, 3, 4, 5, 1};
+  uint8_t b[6] = {1, 2, 3, 4, 5, 2};
+  uint8_t c[6] = {1, 2, 3, 4, 5, 3};
+  uint32_t start = PJON_MICROS();
+  OSPREY_CHECK(roster.next_expiry(start) == OSPREY_NO_DEADLINE);
+  uint8_t id_a = roster.reserve_index(a);
+  test_wait(1000);
+  uint8_t id_b = roster.reserve_index(b);
+  test_wait(1000);
+  uint8_t id_c = roster.reserve_index(c);
+  OSPREY_CHECK(
+    roster.next_expiry(PJON_MICROS()) == OSPREY_ADDRESSING_TIMEOUT - 2000
+  );
+  // Reserved again, a expires after c
+  test_wait(1000);
+  OSPREY_CHECK(roster.reserve_index(a) == id_a);
+  OSPREY_CHECK(
+    roster.next_expiry(PJON_MICROS()) == OSPREY_ADDRESSING_TIMEOUT - 2000
+  );
+  SimulatedClock::micros() = start + 1000 + OSPREY_ADDRESSING_TIMEOUT - 1;
+  OSPREY_CHECK(!roster.free_reserved_id_expired(PJON_MICROS()));
+  test_wait(1);
+  OSPREY_CHECK(roster.free_reserved_id_expired(PJON_MICROS()));
+  OSPREY_CHECK(roster.get_state(id_b) == OSPREY_INDEX_FREE);
+  OSPREY_CHECK(!roster.free_reserved_id_expired(PJON_MICROS()));
+  // Confirmed, c leaves the queue
+  OSPREY_CHECK(roster.confirm_id(id_c, c));
+  OSPREY_CHECK(roster.next_expiry(PJON_MICROS()) == 2000);
+  test_wait(2000);
+  OSPREY_CHECK(roster.free_reserved_id_expired(PJON_MICROS()));
+  OSPREY_CHECK(roster.get_state(id_a) == OSPREY_INDEX_FREE);
+  OSPREY_CHECK(roster.get_state(id_c) == OSPREY_INDEX_ASSIGNED);
+  OSPREY_CHECK(roster.count_reserved() == 0);
+  OSPREY_CHECK(roster.next_expiry(PJON_MICROS()) == OSPREY_NO_DEADLINE);
+};
+
+void test_master() {
+  Master master;
+  master.strategy.set_medium(&medium, &master, receive_master);
+  master.set_error(no_error);
+  master.begin();
+  uint8_t mac[6] = {1, 2, 3, 4, 5, 6};
+  Slave slave(mac);
+  slave.strategy.set_medium(&medium, &slave, receive_slave);
+  slave.set_error(no_error);
+  slave.begin();
+  // Let the OSPREY_ID_LIST of the master end
+  for(uint32_t t = 0; t < 50000; t++) {
+    test_wait(100);
+    master.update();
+  }
+  // The slave does not receive the response to its OSPREY_ID_REQUEST
+  slave_deaf = true;
+  slave.request_id();
+  for(uint32_t t = 0; (t < 1000) && !master.count_reserved(); t++) {
+    test_wait(100);
+    slave.update();
+    master.update();
+  }
+  OSPREY_CHECK(master.count_reserved() == 1);
+  uint32_t reserved = PJON_MICROS();
+  bool kept = true;
+  while((uint32_t)(PJON_MICROS() - reserved) < OSPREY_ADDRESSING_TIMEOUT) {
+    kept = kept && (master.count_reserved() == 1);
+    test_wait(100);
+    master.update();
+  }
+  OSPREY_CHECK(kept);
+  OSPREY_CHECK(master.count_reserved() == 0);
+  OSPREY_CHECK(master.count_slaves() == 0);
+};
+
+int main() {
+  test_queue();
+  test_master();
+  return test_result("Expiry queue");
+};
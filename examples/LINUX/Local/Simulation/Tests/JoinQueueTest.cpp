@@ -0,0 +1,113 @@
+/* Admission of the OSPREY_ID_REQUEST: a join storm is answered at most
+   OSPREY_JOIN_RATE per second after a burst of OSPREY_JOIN_BURST, the
+   requests exceeding OSPREY_JOIN_QUEUE_LENGTH are asked to retry later and
+   the slaves exceeding the devices buffer are asked to retry as well. */
+
+#define OSPREY_JOIN_QUEUE_LENGTH 8
+#define OSPREY_JOIN_RATE        20
+#define OSPREY_JOIN_BURST        4
+
+#include "Test.h"
+#include <OSPREYMaster.h>
+#include <OSPREYSlave.h>
+
+#define MAX_SLAVES 30
+#define SLAVES     40
+
+typedef OSPREYMaster<SimulatedBus, MAX_SLAVES> Master;
+typedef OSPREYSlave<SimulatedBus> Slave;
+
+SimulatedMedium medium;
+Master master;
+Slave *slaves[SLAVES];
+uint16_t retries = 0;
+
+uint16_t receive_master(void *device) {
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_slave(void *device) {
+  return ((Slave *)device)->receive();
+};
+
+void no_error(uint8_t, uint16_t, void *) { };
+
+void slave_receiver(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &info
+) {
+  if(
+    length && (info.port == OSPREY_DYNAMIC_ADDRESSING_PORT) &&
+    (payload[0] == OSPREY_ID_RETRY)
+  ) retries++;
+};
+
+void run(uint32_t duration) {
+  for(uint32_t t = 0; t < duration; t += 100) {
+    test_wait(100);
+    master.update();
+    for(uint8_t i = 0; i < SLAVES; i++) {
+      if(
+        (slaves[i]->addressing_state() == OSPREY_SLAVE_IDLE) &&
+        !slaves[i]->connected
+      ) slaves[i]->request_id();
+      slaves[i]->update();
+    }
+  }
+};
+
+uint8_t count_admitted() {
+  return master.count_slaves() + master.count_reserved();
+};
+
+uint8_t count_connected() {
+  uint8_t result = 0;
+  for(uint8_t i = 0; i < SLAVES; i++)
+    if(slaves[i]->connected) result++;
+  return result;
+};
+
+int main() {
+  medium.collision = 0;
+  master.strategy.set_medium(&medium, &master, receive_master);
+  master.set_error(no_error);
+  master.begin();
+  // Let the OSPREY_ID_LIST of the master end
+  for(uint32_t t = 0; t < 50000; t++) {
+    test_wait(100);
+    master.update();
+  }
+  for(uint8_t i = 0; i < SLAVES; i++) {
+    uint8_t mac[6] = {1, 2, 3, 4, 0, i};
+    slaves[i] = new Slave(mac);
+    slaves[i]->strategy.set_medium(&medium, slaves[i], receive_slave);
+    slaves[i]->set_receiver(slave_receiver);
+    slaves[i]->set_error(no_error);
+    slaves[i]->begin();
+    slaves[i]->request_id();
+  }
+
+  // The burst is answered at once, then a request each OSPREY_JOIN_INTERVAL
+  run(OSPREY_JOIN_INTERVAL / 2);
+  OSPREY_CHECK(count_admitted() == OSPREY_JOIN_BURST);
+  run(OSPREY_JOIN_INTERVAL);
+  OSPREY_CHECK(count_admitted() == OSPREY_JOIN_BURST + 1);
+  // The requests exceeding the queue are asked to retry
+  OSPREY_CHECK(retries > 0);
+
+  // The admission rate is kept
+  uint8_t admitted = count_admitted();
+  run(1000000);
+  OSPREY_CHECK(count_admitted() - admitted <= OSPREY_JOIN_RATE + 1);
+
+  // The devices buffer is filled, the others are asked to retry
+  run(60000000);
+  OSPREY_CHECK(master.count_slaves() == MAX_SLAVES);
+  OSPREY_CHECK(count_connected() == MAX_SLAVES);
+  uint16_t full = retries;
+  run(30000000);
+  OSPREY_CHECK(retries > full);
+  OSPREY_CHECK(count_connected() == MAX_SLAVES);
+  return test_result("Join queue");
+};
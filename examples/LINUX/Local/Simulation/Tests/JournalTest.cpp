@@ -0,0 +1,76 @@
+/* Journal of the devices buffer: a reader following it receives each
+   event once and in order. When OSPREY_JOURNAL_LENGTH events are recorded
+   while it does not read, the oldest are overwritten and the reader is
+   moved to the oldest event kept. */
+
+#define OSPREY_JOURNAL_LENGTH 8
+
+#include "Test.h"
+#include <OSPREYRoster.h>
+
+OSPREYRoster<8> roster;
+uint32_t last = 0;
+
+/* Read the events recorded since the last call, as an application
+   following the journal does, returns the number of events read: */
+
+uint16_t follow(OSPREY_Roster_Event *events, uint16_t max) {
+  uint16_t count = 0;
+  OSPREY_Roster_Event event;
+  for(uint32_t s = last; roster.read_journal(s, event); last = ++s) {
+    OSPREY_CHECK(event.sequence == s);
+    if(count < max) events[count] = event;
+    count++;
+  }
+  return count;
+};
+
+int main() {
+  OSPREY_Roster_Event events[16];
+  // The devices buffer was cleared when created
+  OSPREY_CHECK(follow(events, 16) == 1);
+  OSPREY_CHECK(events[0].type == OSPREY_JOURNAL_EVICTED);
+  OSPREY_CHECK(events[0].id == 0);
+  OSPREY_CHECK(follow(events, 16) == 0);
+
+  uint8_t a[6] = {1, 2, 3, 4, 5, 1};
+  uint8_t b[6] = {1, 2, 3, 4, 5, 2};
+  uint8_t id_a = roster.reserve_index(a);
+  OSPREY_CHECK(roster.confirm_id(id_a, a));
+  OSPREY_CHECK(roster.add_id(id_a, a));
+  uint8_t id_b = roster.reserve_index(b);
+  roster.delete_id_reference(id_b);
+  OSPREY_CHECK(follow(events, 16) == 5);
+  OSPREY_CHECK(events[0].type == OSPREY_JOURNAL_RESERVED);
+  OSPREY_CHECK(events[1].type == OSPREY_JOURNAL_ASSIGNED);
+  OSPREY_CHECK(events[2].type == OSPREY_JOURNAL_REFRESHED);
+  OSPREY_CHECK(events[3].type == OSPREY_JOURNAL_RESERVED);
+  OSPREY_CHECK(events[4].type == OSPREY_JOURNAL_EVICTED);
+  OSPREY_CHECK((events[0].id == id_a) && (events[4].id == id_b));
+  OSPREY_CHECK(PJONTools::id_equality(events[1].mac, a, 6));
+
+  // The reader falls behind more than OSPREY_JOURNAL_LENGTH events
+  uint32_t first = roster.journal_sequence();
+  for(uint8_t i = 0; i < 20; i++) OSPREY_CHECK(roster.add_id(id_a, a));
+  OSPREY_CHECK(roster.journal_sequence() == first + 20);
+  uint32_t s = last;
+  OSPREY_Roster_Event event;
+  OSPREY_CHECK(roster.read_journal(s, event));
+  OSPREY_CHECK(s == first + 20 - OSPREY_JOURNAL_LENGTH);
+  OSPREY_CHECK(event.sequence == s);
+  OSPREY_CHECK(follow(events, 16) == OSPREY_JOURNAL_LENGTH);
+  OSPREY_CHECK(events[0].sequence == first + 20 - OSPREY_JOURNAL_LENGTH);
+  OSPREY_CHECK(
+    events[OSPREY_JOURNAL_LENGTH - 1].sequence ==
+    roster.journal_sequence() - 1
+  );
+  OSPREY_CHECK(last == roster.journal_sequence());
+
+  // Events recorded after the wrap are read as usual
+  roster.delete_id_reference(id_a);
+  OSPREY_CHECK(follow(events, 16) == 1);
+  OSPREY_CHECK(events[0].type == OSPREY_JOURNAL_EVICTED);
+  OSPREY_CHECK(events[0].id == id_a);
+  OSPREY_CHECK(roster.count_slaves() == 0);
+  return test_result("Journal");
+};
@@ -0,0 +1,126 @@
+/* MAC index of the devices buffer: MACs sharing the same home position are
+   inserted, looked up and removed (also across the end of the index), then
+   random reservations, confirmations, refreshes and deletions are checked
+   against a linear search of the devices buffer. A short index is used so
+   that probe sequences are long. */
+
+#define OSPREY_MAC_INDEX true
+#define OSPREY_MAC_INDEX_LENGTH 16
+
+#include "Test.h"
+#include <OSPREYRoster.h>
+
+#define SLAVES 10
+#define MACS   40
+
+OSPREYRoster<SLAVES> roster;
+uint8_t macs[MACS][6];
+
+/* Home position of a MAC in the index (FNV-1a as the devices buffer): */
+
+uint16_t home(const uint8_t *mac) {
+  uint32_t h = 2166136261UL;
+  for(uint8_t i = 0; i < 6; i++) {
+    h ^= mac[i];
+    h *= 16777619UL;
+  }
+  return (uint16_t)(h ^ (h >> 16)) & (OSPREY_MAC_INDEX_LENGTH - 1);
+};
+
+/* Generate a MAC with the home position passed: */
+
+void mac_at(uint16_t position, uint8_t *mac) {
+  do {
+    for(uint8_t i = 0; i < 6; i++) mac[i] = PJON_RANDOM(256);
+  } while(home(mac) != position);
+};
+
+/* Index of a MAC found with a linear search of the devices buffer: */
+
+uint8_t linear_search(const uint8_t *mac) {
+  for(uint8_t i = 0; i < SLAVES; i++)
+    if(
+      (roster.get_state(i + 1) != OSPREY_INDEX_FREE) &&
+      PJONTools::id_equality(roster.ids[i].mac, mac, 6)
+    ) return i;
+  return PJON_NOT_ASSIGNED;
+};
+
+void test_collisions() {
+  /* Three MACs at the last position and one at the first, their probe
+     sequences wrap around the end of the index and overlap: */
+  uint8_t a[3][6], b[6];
+  for(uint8_t i = 0; i < 3; i++) mac_at(OSPREY_MAC_INDEX_LENGTH - 1, a[i]);
+  mac_at(0, b);
+  uint8_t id[3];
+  for(uint8_t i = 0; i < 3; i++) id[i] = roster.reserve_index(a[i]);
+  uint8_t id_b = roster.reserve_index(b);
+  for(uint8_t i = 0; i < 3; i++)
+    OSPREY_CHECK(roster.get_index_from_mac(a[i]) == id[i] - 1);
+  OSPREY_CHECK(roster.get_index_from_mac(b) == id_b - 1);
+  // The removal of the first shifts back the others
+  roster.delete_id_reference(id[0]);
+  OSPREY_CHECK(roster.get_index_from_mac(a[0]) == PJON_NOT_ASSIGNED);
+  OSPREY_CHECK(roster.get_index_from_mac(a[1]) == id[1] - 1);
+  OSPREY_CHECK(roster.get_index_from_mac(a[2]) == id[2] - 1);
+  OSPREY_CHECK(roster.get_index_from_mac(b) == id_b - 1);
+  // Removed from the middle of the probe sequence
+  roster.delete_id_reference(id[2]);
+  OSPREY_CHECK(roster.get_index_from_mac(a[1]) == id[1] - 1);
+  OSPREY_CHECK(roster.get_index_from_mac(b) == id_b - 1);
+  // Inserted again in the position freed
+  id[0] = roster.reserve_index(a[0]);
+  OSPREY_CHECK(roster.confirm_id(id[0], a[0]));
+  OSPREY_CHECK(roster.get_index_from_mac(a[0]) == id[0] - 1);
+  OSPREY_CHECK(roster.get_index_from_mac(b) == id_b - 1);
+  // A MAC moved to another id has one entry
+  uint8_t moved = (id[0] % SLAVES) + 1;
+  while(roster.get_state(moved) != OSPREY_INDEX_FREE)
+    moved = (moved % SLAVES) + 1;
+  OSPREY_CHECK(roster.add_id(moved, a[0]));
+  OSPREY_CHECK(roster.get_state(id[0]) == OSPREY_INDEX_FREE);
+  OSPREY_CHECK(roster.get_index_from_mac(a[0]) == moved - 1);
+  roster.delete_id_reference();
+  OSPREY_CHECK(roster.get_index_from_mac(a[0]) == PJON_NOT_ASSIGNED);
+  OSPREY_CHECK(roster.get_index_from_mac(b) == PJON_NOT_ASSIGNED);
+};
+
+void test_churn() {
+  for(uint8_t m = 0; m < MACS; m++)
+    for(uint8_t i = 0; i < 6; i++) macs[m][i] = PJON_RANDOM(256);
+  uint16_t mismatches = 0, duplicates = 0;
+  for(uint32_t n = 0; n < 20000; n++) {
+    uint8_t *mac = macs[PJON_RANDOM(MACS)];
+    uint8_t operation = PJON_RANDOM(4);
+    if(operation == 0) roster.reserve_index(mac);
+    if(operation == 1) {
+      uint8_t index = roster.get_index_from_mac(mac);
+      if(index != PJON_NOT_ASSIGNED) roster.confirm_id(index + 1, mac);
+    }
+    if(operation == 2) roster.delete_id_reference(PJON_RANDOM(SLAVES) + 1);
+    if(operation == 3) roster.add_id(PJON_RANDOM(SLAVES) + 1, mac);
+    for(uint8_t m = 0; m < MACS; m++) {
+      uint8_t references = 0;
+      for(uint8_t i = 0; i < SLAVES; i++)
+        if(
+          (roster.get_state(i + 1) != OSPREY_INDEX_FREE) &&
+          PJONTools::id_equality(roster.ids[i].mac, macs[m], 6)
+        ) references++;
+      if(references > 1) duplicates++;
+      if(roster.get_index_from_mac(macs[m]) != linear_search(macs[m]))
+        mismatches++;
+    }
+  }
+  OSPREY_CHECK(!mismatches);
+  OSPREY_CHECK(!duplicates);
+  OSPREY_CHECK(
+    roster.count_free() + roster.count_reserved() + roster.count_slaves() ==
+    SLAVES
+  );
+};
+
+int main() {
+  test_collisions();
+  test_churn();
+  return test_result("MAC index");
+};
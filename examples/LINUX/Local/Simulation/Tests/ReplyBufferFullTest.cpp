@@ -0,0 +1,75 @@
+/* Addressing response without the reply stage: if the packets buffer of
+   the master is full the response to an OSPREY_ID_REQUEST is dropped, the
+   error call-back receives PJON_PACKETS_BUFFER_FULL and the id reserved is
+   freed at once instead of waiting for its expiry. The slave joins once
+   the packets buffer has space. */
+
+#define OSPREY_REPLY_QUEUE_LENGTH  0
+#define OSPREY_APPLICATION_PACKETS 0
+
+#include "Test.h"
+#include <OSPREYMaster.h>
+#include <OSPREYSlave.h>
+
+typedef OSPREYMaster<SimulatedBus, 8> Master;
+typedef OSPREYSlave<SimulatedBus> Slave;
+
+SimulatedMedium medium;
+uint16_t buffer_full = 0;
+
+uint16_t receive_master(void *device) {
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_slave(void *device) {
+  return ((Slave *)device)->receive();
+};
+
+void master_error(uint8_t code, uint16_t, void *) {
+  if(code == PJON_PACKETS_BUFFER_FULL) buffer_full++;
+};
+
+void no_error(uint8_t, uint16_t, void *) { };
+
+int main() {
+  medium.collision = 0;
+  Master master;
+  master.strategy.set_medium(&medium, &master, receive_master);
+  master.set_error(master_error);
+  master.begin();
+  uint8_t mac[6] = {1, 2, 3, 4, 5, 6};
+  Slave slave(mac);
+  slave.strategy.set_medium(&medium, &slave, receive_slave);
+  slave.set_error(no_error);
+  slave.begin();
+  // Let the OSPREY_ID_LIST of the master end
+  for(uint32_t t = 0; t < 50000; t++) {
+    test_wait(100);
+    master.update();
+  }
+
+  // Packets to a device that does not exist fill the packets buffer
+  uint16_t packets[PJON_MAX_PACKETS];
+  for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++)
+    packets[i] = master.send(12, "x", 1, master.config | PJON_ACK_REQ_BIT);
+  buffer_full = 0;
+  slave.request_id();
+  for(uint32_t t = 0; (t < 1000) && !buffer_full; t += 100) {
+    test_wait(100);
+    slave.update();
+  }
+  OSPREY_CHECK(buffer_full == 1);
+  OSPREY_CHECK(master.count_reserved() == 0);
+  OSPREY_CHECK(master.count_free() == 8);
+
+  // The slave joins once the packets buffer has space
+  for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++) master.remove(packets[i]);
+  for(uint32_t t = 0; (t < 30000000) && !slave.connected; t += 100) {
+    test_wait(100);
+    master.update();
+    slave.update();
+  }
+  OSPREY_CHECK(slave.connected);
+  OSPREY_CHECK(master.count_slaves() == 1);
+  return test_result("Reply with the packets buffer full");
+};
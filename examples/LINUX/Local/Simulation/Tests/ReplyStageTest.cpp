@@ -0,0 +1,107 @@
+/* Reply stage: while the packets buffer of the master has no more than
+   OSPREY_APPLICATION_PACKETS free slots the addressing responses are held,
+   one for each MAC. A response exceeding OSPREY_REPLY_QUEUE_LENGTH is
+   dropped with PJON_PACKETS_BUFFER_FULL and its id is freed at once, the
+   responses held are transmitted as soon as the packets buffer has space
+   and their slaves join. */
+
+#define OSPREY_REPLY_QUEUE_LENGTH  4
+#define OSPREY_APPLICATION_PACKETS 1
+
+#include "Test.h"
+#include <OSPREYMaster.h>
+#include <OSPREYSlave.h>
+
+#define SLAVES (OSPREY_REPLY_QUEUE_LENGTH + 1)
+
+typedef OSPREYMaster<SimulatedBus, 8> Master;
+typedef OSPREYSlave<SimulatedBus> Slave;
+
+SimulatedMedium medium;
+Master master;
+Slave *slaves[SLAVES];
+uint16_t buffer_full = 0;
+
+uint16_t receive_master(void *device) {
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_slave(void *device) {
+  return ((Slave *)device)->receive();
+};
+
+void master_error(uint8_t code, uint16_t, void *) {
+  if(code == PJON_PACKETS_BUFFER_FULL) buffer_full++;
+};
+
+void no_error(uint8_t, uint16_t, void *) { };
+
+uint8_t count_connected() {
+  uint8_t result = 0;
+  for(uint8_t i = 0; i < SLAVES; i++)
+    if(slaves[i]->connected) result++;
+  return result;
+};
+
+int main() {
+  medium.collision = 0;
+  master.strategy.set_medium(&medium, &master, receive_master);
+  master.set_error(master_error);
+  master.begin();
+  for(uint8_t i = 0; i < SLAVES; i++) {
+    uint8_t mac[6] = {1, 2, 3, 4, 0, i};
+    slaves[i] = new Slave(mac);
+    slaves[i]->strategy.set_medium(&medium, slaves[i], receive_slave);
+    slaves[i]->set_error(no_error);
+    slaves[i]->begin();
+  }
+  // Let the OSPREY_ID_LIST of the master end
+  for(uint32_t t = 0; t < 50000; t++) {
+    test_wait(100);
+    master.update();
+  }
+
+  /* Packets to a device that does not exist leave only the slots of the
+     application packets free: */
+  uint16_t packets[PJON_MAX_PACKETS];
+  uint16_t count = 0;
+  while(count < (PJON_MAX_PACKETS - OSPREY_APPLICATION_PACKETS))
+    packets[count++] =
+      master.send(12, "x", 1, master.config | PJON_ACK_REQ_BIT);
+  buffer_full = 0;
+  for(uint8_t i = 0; i < SLAVES; i++) slaves[i]->request_id();
+  for(uint32_t t = 0; t < 100000; t += 100) {
+    test_wait(100);
+    for(uint8_t i = 0; i < SLAVES; i++) slaves[i]->update();
+    master.update();
+  }
+  // The responses are held, the one exceeding the stage is dropped
+  OSPREY_CHECK(buffer_full == 1);
+  OSPREY_CHECK(master.count_reserved() == OSPREY_REPLY_QUEUE_LENGTH);
+  OSPREY_CHECK(count_connected() == 0);
+  OSPREY_CHECK(master.update_delay() > 0);
+
+  // The responses held are transmitted once the packets buffer has space
+  for(uint16_t i = 0; i < count; i++) master.remove(packets[i]);
+  OSPREY_CHECK(master.update_delay() == 0);
+  for(uint32_t t = 0; t < 100000; t += 100) {
+    test_wait(100);
+    master.update();
+    for(uint8_t i = 0; i < SLAVES; i++) slaves[i]->update();
+  }
+  OSPREY_CHECK(master.count_slaves() >= OSPREY_REPLY_QUEUE_LENGTH);
+
+  // The slave which response was dropped joins later
+  for(
+    uint32_t t = 0;
+    (t < 30000000) && (count_connected() < SLAVES);
+    t += 100
+  ) {
+    test_wait(100);
+    master.update();
+    for(uint8_t i = 0; i < SLAVES; i++) slaves[i]->update();
+  }
+  OSPREY_CHECK(count_connected() == SLAVES);
+  OSPREY_CHECK(master.count_slaves() == SLAVES);
+  return test_result("Reply stage");
+};
@@ -0,0 +1,144 @@
+/* Hot-standby master: the standby replicates the devices buffer of the
+   primary and takes over OSPREY_MASTER_ID once the primary is silent for
+   OSPREY_HEARTBEAT_TIMEOUT, the slaves keep their ids and new slaves join.
+   When the old primary resumes it receives the heartbeat of the higher
+   epoch and steps down, so the bus has a single primary again. */
+
+#include "Test.h"
+#include <OSPREYReplicatedMaster.h>
+#include <OSPREYSlave.h>
+
+#define SLAVES 10
+
+typedef OSPREYReplicatedMaster<SimulatedBus, 30> Master;
+typedef OSPREYSlave<SimulatedBus> Slave;
+
+SimulatedMedium medium;
+Master primary;
+Master standby(OSPREY_ROLE_STANDBY);
+Slave *slaves[SLAVES + 1];
+uint8_t slaves_count = 0;
+bool primary_stalled = false;
+
+uint16_t receive_primary(void *device) {
+  if(primary_stalled) return PJON_FAIL;
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_master(void *device) {
+  return ((Master *)device)->receive();
+};
+
+uint16_t receive_slave(void *device) {
+  return ((Slave *)device)->receive();
+};
+
+void no_error(uint8_t, uint16_t, void *) { };
+
+void add_slave() {
+  uint8_t mac[6] = {1, 2, 3, 4, 0, slaves_count};
+  Slave *slave = new Slave(mac);
+  slave->strategy.set_medium(&medium, slave, receive_slave);
+  slave->set_error(no_error);
+  slave->begin();
+  slave->request_id();
+  slaves[slaves_count++] = slave;
+};
+
+/* Run the devices for the duration passed, a stalled primary is not
+   updated and does not receive: */
+
+void run(uint32_t duration) {
+  for(uint32_t t = 0; t < duration; t += 100) {
+    test_wait(100);
+    if(!primary_stalled) primary.update();
+    standby.update();
+    for(uint8_t i = 0; i < slaves_count; i++) {
+      if(
+        (slaves[i]->addressing_state() == OSPREY_SLAVE_IDLE) &&
+        !slaves[i]->connected
+      ) slaves[i]->request_id();
+      slaves[i]->update();
+    }
+  }
+};
+
+uint8_t count_connected() {
+  uint8_t result = 0;
+  for(uint8_t i = 0; i < slaves_count; i++)
+    if(slaves[i]->connected) result++;
+  return result;
+};
+
+bool ids_kept(const uint8_t *ids) {
+  for(uint8_t i = 0; i < SLAVES; i++)
+    if(slaves[i]->device_id() != ids[i]) return false;
+  return true;
+};
+
+bool same_devices_buffer(Master &a, Master &b) {
+  for(uint8_t id = 1; id <= 30; id++)
+    if(
+      (a.get_state(id) != b.get_state(id)) || (
+        a.get_state(id) &&
+        !PJONTools::id_equality(a.ids[id - 1].mac, b.ids[id - 1].mac, 6)
+      )
+    ) return false;
+  return true;
+};
+
+int main() {
+  medium.collision = 0;
+  primary.strategy.set_medium(&medium, &primary, receive_primary);
+  standby.strategy.set_medium(&medium, &standby, receive_master);
+  primary.set_error(no_error);
+  standby.set_error(no_error);
+  primary.begin();
+  standby.begin();
+  for(uint8_t i = 0; i < SLAVES; i++) add_slave();
+  run(20000000);
+  OSPREY_CHECK(count_connected() == SLAVES);
+  OSPREY_CHECK(primary.count_slaves() == SLAVES);
+  OSPREY_CHECK(standby.count_slaves() == SLAVES);
+  OSPREY_CHECK(same_devices_buffer(primary, standby));
+  uint8_t ids[SLAVES];
+  for(uint8_t i = 0; i < SLAVES; i++) ids[i] = slaves[i]->device_id();
+
+  /* The standby takes over OSPREY_HEARTBEAT_TIMEOUT after the last packet
+     of the primary, which heartbeat is at most OSPREY_HEARTBEAT_TIME old
+     when it stalls, plus the update() deferring the take over: */
+  primary_stalled = true;
+  uint32_t stalled = PJON_MICROS();
+  while(
+    (standby.role() == OSPREY_ROLE_STANDBY) &&
+    ((uint32_t)(PJON_MICROS() - stalled) < (4 * OSPREY_HEARTBEAT_TIMEOUT))
+  ) run(100);
+  uint32_t take_over = PJON_MICROS() - stalled;
+  OSPREY_CHECK(standby.role() == OSPREY_ROLE_PRIMARY);
+  OSPREY_CHECK(
+    take_over >= (OSPREY_HEARTBEAT_TIMEOUT - OSPREY_HEARTBEAT_TIME)
+  );
+  OSPREY_CHECK(take_over <= (OSPREY_HEARTBEAT_TIMEOUT + 200));
+  OSPREY_CHECK(standby.device_id() == OSPREY_MASTER_ID);
+  OSPREY_CHECK(standby.epoch() == 1);
+  OSPREY_CHECK(standby.count_slaves() == SLAVES);
+
+  // Slaves keep their ids, a new slave joins the new primary
+  add_slave();
+  run(10000000);
+  OSPREY_CHECK(ids_kept(ids));
+  OSPREY_CHECK(count_connected() == SLAVES + 1);
+  OSPREY_CHECK(standby.count_slaves() == SLAVES + 1);
+
+  // The old primary resumes and steps down to the higher epoch
+  primary_stalled = false;
+  run(5000000);
+  OSPREY_CHECK(primary.role() == OSPREY_ROLE_STANDBY);
+  OSPREY_CHECK(primary.device_id() == OSPREY_STANDBY_ID);
+  OSPREY_CHECK(primary.epoch() == 1);
+  OSPREY_CHECK(standby.role() == OSPREY_ROLE_PRIMARY);
+  OSPREY_CHECK(same_devices_buffer(primary, standby));
+  OSPREY_CHECK(ids_kept(ids));
+  OSPREY_CHECK(count_connected() == SLAVES + 1);
+  return test_result("Standby");
+};
@@ -0,0 +1,45 @@
+/* Behavioural tests of OSPREY, each test is a program connecting masters
+   and slaves to a SimulatedMedium (see ../ConvergenceBenchmark) and running
+   them in virtual time. A test defines its configuration before including
+   Test.h, checks the expected behaviour with OSPREY_CHECK and returns
+   test_result() from main, so make test stops at the first failing test.
+
+   Compile and run from this directory (PJON_PATH points to PJON's src
+   directory):
+   make test PJON_PATH=../../../../../../PJON/src */
+
+#pragma once
+#include "SimulatedBus.h"
+#include <stdio.h>
+
+static uint16_t test_checks = 0;
+static uint16_t test_failures = 0;
+
+#define OSPREY_CHECK(condition) test_check(condition, #condition, __LINE__)
+
+/* Count a check, a failure is reported with its line: */
+
+void test_check(bool result, const char *condition, uint16_t line) {
+  test_checks++;
+  if(result) return;
+  test_failures++;
+  printf("  line %u: %s failed\n", line, condition);
+};
+
+/* Report the result of the test, returns the exit status of the program: */
+
+int test_result(const char *name) {
+  printf(
+    "%s: %u checks, %u failed\n",
+    name,
+    test_checks,
+    test_failures
+  );
+  return test_failures ? 1 : 0;
+};
+
+/* Advance the virtual clock: */
+
+void test_wait(uint32_t duration) {
+  SimulatedClock::micros() += duration;
+};
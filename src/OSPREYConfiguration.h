@@ -0,0 +1,49 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+
+#pragma once
+#include "OSPREYDefines.h"
+
+/* The configuration of the master is identified by the CRC32 of its
+   content, slaves transmit the hash of the configuration they know with
+   OSPREY_ID_REQUEST and the master sends the content only if it differs.
+   The hash is transmitted most significant byte first. */
+
+static inline uint32_t OSPREY_configuration_hash(
+  const uint8_t *configuration,
+  uint16_t length
+) {
+  return PJON_crc32::compute(configuration, length);
+};
+
+static inline uint32_t OSPREY_read_hash(const uint8_t *data) {
+  return
+    ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+    ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+};
+
+static inline void OSPREY_write_hash(uint8_t *data, uint32_t hash) {
+  data[0] = (uint8_t)(hash >> 24);
+  data[1] = (uint8_t)(hash >> 16);
+  data[2] = (uint8_t)(hash >> 8);
+  data[3] = (uint8_t)hash;
+};
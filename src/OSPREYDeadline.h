@@ -0,0 +1,73 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "OSPREYDefines.h"
+
+/* Deadlines of the timed work done by update(), used by update_delay() to
+   let the application sleep until update() is required. Delays are in
+   microseconds, OSPREY_NO_DEADLINE if nothing is scheduled. */
+
+/* Earliest of two delays: */
+
+static inline uint32_t OSPREY_earliest(uint32_t a, uint32_t b) {
+  return (a < b) ? a : b;
+};
+
+/* Delay until duration elapses since time, 0 if it already elapsed: */
+
+static inline uint32_t OSPREY_remaining(
+  uint32_t time,
+  uint32_t duration,
+  uint32_t now
+) {
+  uint32_t elapsed = now - time;
+  return (elapsed >= duration) ? 0 : duration - elapsed;
+};
+
+/* Convert a delay in milliseconds: */
+
+static inline uint32_t OSPREY_millis_delay(uint32_t delay) {
+  if(delay == OSPREY_NO_DEADLINE) return OSPREY_NO_DEADLINE;
+  return (delay < (OSPREY_NO_DEADLINE / 1000)) ?
+    delay * 1000 : OSPREY_NO_DEADLINE - 1;
+};
+
+/* Delay until PJON transmits or retries the next packet of the buffer. If
+   the strategy uses a random back-off it is an estimate, update() may be
+   called slightly earlier or later than the retry is due: */
+
+template<typename Bus>
+uint32_t OSPREY_packets_delay(Bus &bus, uint32_t now) {
+  uint32_t delay = OSPREY_NO_DEADLINE;
+  for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++)
+    if(bus.packets[i].state)
+      delay = OSPREY_earliest(
+        delay,
+        OSPREY_remaining(
+          bus.packets[i].registration,
+          bus.packets[i].timing +
+          bus.strategy.back_off(bus.packets[i].attempts) + 1,
+          now
+        )
+      );
+  return delay;
+};
@@ -31,10 +31,73 @@
   #define OSPREY_MAX_SLAVES              25
 #endif
 
+/* MAC to device index hash table (open addressing), set to false to save
+   memory and use a linear search of the devices buffer instead */
+#ifndef OSPREY_MAC_INDEX
+  #if defined(__AVR__)
+    #define OSPREY_MAC_INDEX          false
+  #else
+    #define OSPREY_MAC_INDEX           true
+  #endif
+#endif
+/* OSPREY_MAC_INDEX_LENGTH can be defined to set the length of the MAC index
+   (power of 2 larger than the number of slots), by default it is the lowest
+   power of 2 at least twice the number of slots of each devices buffer */
+
+/* Compact devices buffer for memory constrained masters, the state of each
+   id is kept only in the bitmaps, reserved ids are not queued (the expiry
+   check scans them) and times are saved in 16 bits ticks */
+#ifndef OSPREY_COMPACT_ROSTER
+  #define OSPREY_COMPACT_ROSTER       false
+#endif
+/* Ticks of the compact devices buffer, 2^10 microseconds or milliseconds by
+   default (at most 16), longer ticks allow longer leases */
+#ifndef OSPREY_COMPACT_TICK_SHIFT
+  #define OSPREY_COMPACT_TICK_SHIFT      10
+#endif
+
+/* Events of the devices buffer kept in its journal (power of 2), 0 does not
+   record them */
+#ifndef OSPREY_JOURNAL_LENGTH
+  #define OSPREY_JOURNAL_LENGTH           0
+#endif
+// Devices buffer journal events
+#define OSPREY_JOURNAL_RESERVED           1
+#define OSPREY_JOURNAL_ASSIGNED           2
+#define OSPREY_JOURNAL_REFRESHED          3
+#define OSPREY_JOURNAL_EVICTED            4
+#define OSPREY_JOURNAL_EXPIRED            5
+
+// Version of the data saved in storage by OSPREY
+#define OSPREY_STORAGE_VERSION            1
+// Length of each device reference saved by master (state and MAC)
+#define OSPREY_STORAGE_RECORD_LENGTH      7
+// Length of the identity saved by slaves (version, MAC, bus id, id and
+// configuration length) followed by the master's configuration
+#define OSPREY_SLAVE_STORAGE_LENGTH      14
+
+// Returned by update_delay() if update() has no timed work scheduled
+#define OSPREY_NO_DEADLINE       0xFFFFFFFF
+
+// Collect addressing telemetry (see OSPREYTelemetry.h)
+#ifndef OSPREY_TELEMETRY
+  #define OSPREY_TELEMETRY            false
+#endif
+// Join latency histogram buckets, bucket i counts latencies < 2^i ms
+#ifndef OSPREY_TELEMETRY_BUCKETS
+  #define OSPREY_TELEMETRY_BUCKETS       14
+#endif
+
 // Configuration payload length added to OSPREY_ID_CONFIRM requests by master
 #ifndef OSPREY_CONFIGURATION_LENGTH
   #define OSPREY_CONFIGURATION_LENGTH     0
 #endif
+/* Slaves transmit the hash of the master's configuration they know with
+   OSPREY_ID_REQUEST, set to true only if the master supports the format
+   with hash, a master that does not responds without it */
+#ifndef OSPREY_CONFIGURATION_HASH
+  #define OSPREY_CONFIGURATION_HASH    false
+#endif
 
 #define OSPREY_INDEX_FREE                 0
 #define OSPREY_INDEX_RESERVED             1
@@ -43,20 +106,186 @@
 // Dynamic addressing
 #define OSPREY_ID_REQUEST               200
 #define OSPREY_ID_CONFIRM               201
+#define OSPREY_ID_ASSIGN                202
 #define OSPREY_ID_NEGATE                203
 #define OSPREY_ID_LIST                  204
 #define OSPREY_ID_REFRESH               205
+#define OSPREY_ID_RENEW                 206
+#define OSPREY_ID_DIRECTORY             207
+#define OSPREY_ID_CONFIGURATION         208
+#define OSPREY_ID_RETRY                 209
+#define OSPREY_ID_PROBE                 213
+
+// Slave addressing states
+#define OSPREY_SLAVE_IDLE                 0
+#define OSPREY_SLAVE_REQUESTING           1
+#define OSPREY_SLAVE_CONFIRMING           2
+#define OSPREY_SLAVE_CONNECTED            3
+#define OSPREY_SLAVE_REFRESHING           4
+#define OSPREY_SLAVE_RELEASING            5
 
 // Errors
 #define OSPREY_ID_ACQUISITION_FAIL      105
 #define OSPREY_DEVICES_BUFFER_FULL      254
+#define OSPREY_DIRECTORY_FULL           253
 
 // Dynamic addressing port number
 #define OSPREY_DYNAMIC_ADDRESSING_PORT    1
 
+// Device id of the standby master
+#ifndef OSPREY_STANDBY_ID
+  #define OSPREY_STANDBY_ID             253
+#endif
+// Port used by the primary master to replicate its devices buffer
+#ifndef OSPREY_REPLICATION_PORT
+  #define OSPREY_REPLICATION_PORT         2
+#endif
+// Replication requests
+#define OSPREY_REPLICA_HEARTBEAT        210
+#define OSPREY_REPLICA_UPDATE           211
+#define OSPREY_REPLICA_SYNC             212
+// Master roles
+#define OSPREY_ROLE_PRIMARY               0
+#define OSPREY_ROLE_STANDBY               1
+
+// Header bits required by addressing packets
+#define OSPREY_ADDRESSING_HEADER \
+  (PJON_PORT_BIT | PJON_TX_INFO_BIT | PJON_CRC_BIT | PJON_MAC_BIT)
+
 // Master ID_REQUEST and ID_NEGATE timeout
 #define OSPREY_ADDRESSING_TIMEOUT   4000000
 // Master reception time during LIST_ID broadcast (250 milliseconds)
 #define OSPREY_LIST_IDS_TIME         250000
+/* OSPREY_ID_LIST includes a page of the id space and the bitmap of the ids
+   in the page known by master, only slaves in the page not known respond.
+   Slaves not supporting it respond to all pages, it is disabled by default */
+#ifndef OSPREY_ID_LIST_ROSTER
+  #define OSPREY_ID_LIST_ROSTER        false
+#endif
+// Ids included in each OSPREY_ID_LIST page (multiple of 8, at most 248)
+#ifndef OSPREY_ID_LIST_PAGE_LENGTH
+  #define OSPREY_ID_LIST_PAGE_LENGTH     64
+#endif
+/* Master collects the OSPREY_ID_REQUEST received within OSPREY_ID_BATCH_TIME
+   and assigns their ids broadcasting a single OSPREY_ID_ASSIGN */
+#ifndef OSPREY_ID_BATCH
+  #define OSPREY_ID_BATCH             false
+#endif
+/* Maximum MAC and id pairs included in each OSPREY_ID_ASSIGN, the packet is
+   2 + (7 * OSPREY_ID_BATCH_LENGTH) + configuration length bytes long */
+#ifndef OSPREY_ID_BATCH_LENGTH
+  #define OSPREY_ID_BATCH_LENGTH          4
+#endif
+// OSPREY_ID_REQUEST collection window (20 milliseconds)
+#ifndef OSPREY_ID_BATCH_TIME
+  #define OSPREY_ID_BATCH_TIME        20000
+#endif
+/* Lease of the assigned ids (milliseconds), 0 disables leases. Slaves renew
+   it transmitting OSPREY_ID_RENEW after half of its duration, any packet of
+   the slave including its MAC (PJON_MAC_BIT) renews it as well and, if
+   acknowledged, postpones the OSPREY_ID_RENEW. Master frees the ids which
+   lease expired */
+#ifndef OSPREY_LEASE_TIME
+  #define OSPREY_LEASE_TIME               0
+#endif
+/* Master queues the OSPREY_ID_REQUEST received (one entry per MAC) and
+   answers them in update() at most OSPREY_JOIN_RATE per second, with bursts
+   of OSPREY_JOIN_BURST. 0 answers each request when it is received */
+#ifndef OSPREY_JOIN_QUEUE_LENGTH
+  #define OSPREY_JOIN_QUEUE_LENGTH        0
+#endif
+#ifndef OSPREY_JOIN_RATE
+  #define OSPREY_JOIN_RATE               50
+#endif
+// Time between the tokens of the join rate (microseconds)
+#define OSPREY_JOIN_INTERVAL (1000000 / OSPREY_JOIN_RATE)
+#ifndef OSPREY_JOIN_BURST
+  #define OSPREY_JOIN_BURST               4
+#endif
+/* OSPREY_ID_RETRY delay suggested to slaves when the devices buffer is full
+   (milliseconds) */
+#ifndef OSPREY_RETRY_FULL_TIME
+  #define OSPREY_RETRY_FULL_TIME      10000
+#endif
+/* Addressing responses pending (one for each MAC), a newer response to the
+   same MAC replaces the pending one. 0 transmits each response at once */
+#ifndef OSPREY_REPLY_QUEUE_LENGTH
+  #define OSPREY_REPLY_QUEUE_LENGTH       0
+#endif
+/* Priority of the application packets, the packets buffer slots master
+   leaves free for them. Addressing responses are held until more slots are
+   free, 0 gives them the same priority */
+#ifndef OSPREY_APPLICATION_PACKETS
+  #define OSPREY_APPLICATION_PACKETS      0
+#endif
+/* Master probes an assigned id every OSPREY_PROBE_INTERVAL microseconds (in
+   round robin order) and frees it after OSPREY_PROBE_MISSES consecutive
+   probes lost, 0 disables probing */
+#ifndef OSPREY_PROBE_INTERVAL
+  #define OSPREY_PROBE_INTERVAL           0
+#endif
+#ifndef OSPREY_PROBE_MISSES
+  #define OSPREY_PROBE_MISSES             3
+#endif
+// Slaves of the sub-masters known by OSPREYRootMaster
+#ifndef OSPREY_DIRECTORY_LENGTH
+  #define OSPREY_DIRECTORY_LENGTH       256
+#endif
+// Devices included in each OSPREY_ID_DIRECTORY page sent by sub-masters
+#ifndef OSPREY_DIRECTORY_PAGE_LENGTH
+  #define OSPREY_DIRECTORY_PAGE_LENGTH    4
+#endif
+// Sub-master full directory report interval (60 seconds)
+#ifndef OSPREY_DIRECTORY_TIME
+  #define OSPREY_DIRECTORY_TIME    60000000
+#endif
+/* Root master removes the slaves of a sub-master which does not report for
+   3 report intervals (microseconds) */
+#ifndef OSPREY_DIRECTORY_TIMEOUT
+  #define OSPREY_DIRECTORY_TIMEOUT (3 * (uint32_t)OSPREY_DIRECTORY_TIME)
+#endif
+/* Multi master acknowledges the packets sent to OSPREY_MASTER_ID of the
+   additional buses it serves, in router mode PJON acknowledges only the
+   packets sent to its own device id and bus id. Set it to false if the
+   PJON version used acknowledges them */
+#ifndef OSPREY_MULTI_MASTER_ACK
+  #define OSPREY_MULTI_MASTER_ACK true
+#endif
+// Device ids included in each OSPREY_REPLICA_UPDATE
+#ifndef OSPREY_REPLICATION_PAGE_LENGTH
+  #define OSPREY_REPLICATION_PAGE_LENGTH  4
+#endif
+// Primary master heartbeat interval (100 milliseconds)
+#ifndef OSPREY_HEARTBEAT_TIME
+  #define OSPREY_HEARTBEAT_TIME      100000
+#endif
+// Standby master takes over if no heartbeat is received (300 milliseconds)
+#ifndef OSPREY_HEARTBEAT_TIMEOUT
+  #define OSPREY_HEARTBEAT_TIMEOUT   300000
+#endif
 // Slave max collision delay when OSPREY_ID_LIST is received (250 milliseconds)
 #define OSPREY_COLLISION_DELAY          250
+
+/* Slave response window to a OSPREY_ID_LIST, each slave expected to respond
+   (advertised by master or estimated from the page) adds a slot of
+   OSPREY_RESPONSE_SLOT microseconds to the window */
+#ifndef OSPREY_RESPONSE_SLOT
+  #define OSPREY_RESPONSE_SLOT         5000
+#endif
+#ifndef OSPREY_RESPONSE_WINDOW_MIN
+  #define OSPREY_RESPONSE_WINDOW_MIN  20000
+#endif
+#ifndef OSPREY_RESPONSE_WINDOW_MAX
+  #define OSPREY_RESPONSE_WINDOW_MAX 2000000
+#endif
+
+/* Slave exponential backoff, after n consecutive failures of OSPREY_ID_REQUEST
+   or OSPREY_ID_CONFIRM a new OSPREY_ID_REQUEST is transmitted after a random
+   delay lower than OSPREY_BACKOFF_BASE * 2^(n - 1), at most OSPREY_BACKOFF_MAX
+   (milliseconds) */
+#ifndef OSPREY_BACKOFF_BASE
+  #define OSPREY_BACKOFF_BASE          1000
+#endif
+#ifndef OSPREY_BACKOFF_MAX
+  #define OSPREY_BACKOFF_MAX           8000
+#endif
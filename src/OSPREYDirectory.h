@@ -0,0 +1,190 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+
+#pragma once
+#include "OSPREYDefines.h"
+
+/* Location of a slave of a sub-master, a free entry has id 0: */
+
+struct OSPREY_Directory_Entry {
+  uint8_t  mac[6] = {0, 0, 0, 0, 0, 0};
+  uint8_t  bus_id[4] = {0, 0, 0, 0};
+  uint8_t  id = 0;
+  // Last page received from the sub-master of the bus (microseconds)
+  uint32_t report = 0;
+};
+
+/* Directory of the slaves served by the sub-masters of a root master, it is
+   updated with the OSPREY_ID_DIRECTORY pages they transmit. Each page lists
+   the ids assigned in a range of the sub-master's bus:
+   OSPREY_ID_DIRECTORY - FIRST ID - LAST ID - (MAC - DEVICE ID) * COUNT
+   The slaves of a bus which sub-master does not transmit any page for
+   OSPREY_DIRECTORY_TIMEOUT are removed by free_expired(). */
+
+template<uint16_t Length = OSPREY_DIRECTORY_LENGTH>
+class OSPREYDirectory {
+  static_assert(
+    OSPREY_DIRECTORY_TIMEOUT < 0x80000000,
+    "OSPREY_DIRECTORY_TIMEOUT must be shorter than 2^31 microseconds"
+  );
+
+  public:
+    OSPREY_Directory_Entry entries[Length];
+
+    /* Remove all the entries: */
+
+    void clear() {
+      for(uint16_t i = 0; i < Length; i++) entries[i].id = 0;
+      _count = 0;
+    };
+
+    /* Count the slaves known: */
+
+    uint16_t count() const {
+      return _count;
+    };
+
+    /* Check the next entry (one for each call in round robin order) and
+       remove it if its sub-master did not report for
+       OSPREY_DIRECTORY_TIMEOUT, returns true if removed: */
+
+    bool free_expired(uint32_t now) {
+      if(++_expiry_index >= Length) _expiry_index = 0;
+      if(
+        !entries[_expiry_index].id ||
+        ((uint32_t)(now - entries[_expiry_index].report) <
+          OSPREY_DIRECTORY_TIMEOUT)
+      ) return false;
+      free(_expiry_index);
+      return true;
+    };
+
+    /* Find the entry of a MAC address, returns Length if not found: */
+
+    uint16_t find(const uint8_t *mac) const {
+      for(uint16_t i = 0; i < Length; i++)
+        if(entries[i].id && PJONTools::id_equality(entries[i].mac, mac, 6))
+          return i;
+      return Length;
+    };
+
+    /* Delay until the first entry expires (microseconds), the next call of
+       free_expired checks the entry which expires first: */
+
+    uint32_t next_expiry(uint32_t now) {
+      uint32_t delay = OSPREY_NO_DEADLINE;
+      for(uint16_t i = 0; i < Length; i++) {
+        if(!entries[i].id) continue;
+        uint32_t elapsed = now - entries[i].report;
+        uint32_t remaining = (elapsed >= OSPREY_DIRECTORY_TIMEOUT) ?
+          0 : OSPREY_DIRECTORY_TIMEOUT - elapsed;
+        if(remaining >= delay) continue;
+        delay = remaining;
+        _expiry_index = i ? i - 1 : Length - 1;
+      }
+      return delay;
+    };
+
+    /* Remove the slaves of a bus, all of them if id is 0: */
+
+    void remove(const uint8_t *bus_id, uint8_t id = 0) {
+      for(uint16_t i = 0; i < Length; i++)
+        if(
+          entries[i].id && (!id || (entries[i].id == id)) &&
+          PJONTools::id_equality(entries[i].bus_id, bus_id, 4)
+        ) free(i);
+    };
+
+    /* Apply a OSPREY_ID_DIRECTORY page received from the sub-master of a
+       bus, the slaves of the range not listed are removed and the report
+       time of all the slaves of the bus is updated. Returns false if the
+       page is not valid or if the directory is full: */
+
+    bool update(const uint8_t *bus_id, const uint8_t *page, uint16_t length) {
+      if(
+        (length < 3) || (page[0] != OSPREY_ID_DIRECTORY) ||
+        !page[1] || (page[2] < page[1]) || ((length - 3) % 7)
+      ) return false;
+      uint32_t now = PJON_MICROS();
+      for(uint16_t i = 0; i < Length; i++) {
+        if(
+          !entries[i].id ||
+          !PJONTools::id_equality(entries[i].bus_id, bus_id, 4)
+        ) continue;
+        if(
+          (entries[i].id >= page[1]) && (entries[i].id <= page[2]) &&
+          !listed(entries[i], page, length)
+        ) free(i);
+        else entries[i].report = now;
+      }
+      bool result = true;
+      for(uint16_t e = 3; e < length; e += 7) {
+        if((page[e + 6] < page[1]) || (page[e + 6] > page[2])) continue;
+        uint16_t i = find(page + e);
+        if(i == Length) i = find_free();
+        if(i == Length) {
+          result = false;
+          continue;
+        }
+        if(!entries[i].id) _count++;
+        entries[i].id = page[e + 6];
+        entries[i].report = now;
+        PJONTools::copy_id(entries[i].mac, page + e, 6);
+        PJONTools::copy_id(entries[i].bus_id, bus_id, 4);
+      }
+      return result;
+    };
+
+  private:
+    uint16_t _count = 0;
+    uint16_t _expiry_index = 0;
+
+    /* Find a free entry, returns Length if the directory is full: */
+
+    uint16_t find_free() const {
+      for(uint16_t i = 0; i < Length; i++)
+        if(!entries[i].id) return i;
+      return Length;
+    };
+
+    /* Free an entry: */
+
+    void free(uint16_t i) {
+      entries[i].id = 0;
+      _count--;
+    };
+
+    /* Check if an entry is listed in a OSPREY_ID_DIRECTORY page: */
+
+    static bool listed(
+      const OSPREY_Directory_Entry &entry,
+      const uint8_t *page,
+      uint16_t length
+    ) {
+      for(uint16_t e = 3; e < length; e += 7)
+        if(
+          (page[e + 6] == entry.id) &&
+          PJONTools::id_equality(page + e, entry.mac, 6)
+        ) return true;
+      return false;
+    };
+};
@@ -20,7 +20,9 @@
           \*/
 
 #pragma once
-#include "OSPREYDefines.h"
+#include "OSPREYConfiguration.h"
+#include "OSPREYRoster.h"
+#include "OSPREYTelemetry.h"
 
 typedef void (* OSPREY_found_slave)(
   PJON_Endpoint endpoint,
@@ -34,18 +36,72 @@ static void OSPREY_dummy_found_slave(
   uint16_t
 ) {};
 
-/* Reference to device */
-struct Device_reference {
-  uint8_t  mac[6] = {0, 0, 0, 0, 0, 0};
-  uint8_t  state  = 0;
-  uint32_t registration = 0;
+/* Default OSPREYMaster handlers policy, calls the functions set at runtime
+   passing the application's custom pointer. Any class defining the same
+   error, found_slave and receiver methods can be passed as the Handlers
+   template parameter to have the handlers called directly (and inlined): */
+
+struct OSPREYMasterCallbacks {
+  void              *custom_pointer = NULL;
+  PJON_Error         error_function = PJON_dummy_error_handler;
+  OSPREY_found_slave found_slave_function = OSPREY_dummy_found_slave;
+  PJON_Receiver      receiver_function = PJON_dummy_receiver_handler;
+
+  void error(uint8_t code, uint16_t data) {
+    error_function(code, data, custom_pointer);
+  };
+
+  void found_slave(
+    const PJON_Endpoint &endpoint,
+    const uint8_t *configuration,
+    uint16_t length
+  ) {
+    found_slave_function(endpoint, configuration, length);
+  };
+
+  /* The receiver function is called with a copy of the packet info that
+     contains the application's custom pointer: */
+
+  void receiver(
+    uint8_t *payload,
+    uint16_t length,
+    const PJON_Packet_Info &packet_info
+  ) {
+    PJON_Packet_Info info = packet_info;
+    info.custom_pointer = custom_pointer;
+    receiver_function(payload, length, info);
+  };
 };
 
-template<typename Strategy>
-class OSPREYMaster : public PJON<Strategy> {
+/* The number of device ids (at most 253), the configuration length and the
+   handlers policy default to OSPREY_MAX_SLAVES, OSPREY_CONFIGURATION_LENGTH
+   and to the function pointers set at runtime:
+   OSPREYMaster<SoftwareBitBang> master;
+   OSPREYMaster<LocalUDP, 200, 4, MyHandlers> big_master; */
+
+template<
+  typename Strategy,
+  uint8_t MaxSlaves = OSPREY_MAX_SLAVES,
+  uint16_t ConfigurationLength = OSPREY_CONFIGURATION_LENGTH,
+  typename Handlers = OSPREYMasterCallbacks
+>
+class OSPREYMaster : public PJON<Strategy>, public OSPREYRoster<MaxSlaves> {
+  static_assert(
+    MaxSlaves && (MaxSlaves <= 253),
+    "MaxSlaves must be between 1 and 253"
+  );
+  #if OSPREY_ID_LIST_ROSTER
+    static_assert(
+      OSPREY_ID_LIST_PAGE_LENGTH && !(OSPREY_ID_LIST_PAGE_LENGTH % 8) &&
+      (OSPREY_ID_LIST_PAGE_LENGTH <= 248),
+      "OSPREY_ID_LIST_PAGE_LENGTH must be a multiple of 8 between 8 and 248"
+    );
+  #endif
+
   public:
-    Device_reference ids[OSPREY_MAX_SLAVES];
-    uint8_t configuration[OSPREY_CONFIGURATION_LENGTH];
+    uint8_t configuration[ConfigurationLength];
+    uint16_t configuration_length = ConfigurationLength;
+    Handlers handlers;
     uint8_t required_config =
       PJON_TX_INFO_BIT | PJON_CRC_BIT | PJON_ACK_REQ_BIT |
       PJON_PORT_BIT | PJON_MAC_BIT;
@@ -69,91 +125,37 @@ class OSPREYMaster : public PJON<Strategy> {
       set_default();
     };
 
-    /* Add a device reference: */
-
-    bool add_id(uint8_t id, const uint8_t *mac) {
-      if(
-        PJONTools::id_equality(ids[id - 1].mac, mac, 6) ||
-        (ids[id - 1].state == OSPREY_INDEX_FREE)
-      ) {
-        PJONTools::copy_id(ids[id - 1].mac, mac, 6);
-        ids[id - 1].state = OSPREY_INDEX_ASSIGNED;
-        return true;
-      }
-      return false;
-    };
-
-    /* Master begin function: */
+    /* Master begin function, if a storage is set the devices buffer is
+       restored and only the slaves not known are listed: */
 
     void begin() {
       PJON<Strategy>::begin();
-      delete_id_reference();
-      _list_time = PJON_MICROS();
-      uint8_t request = OSPREY_ID_LIST;
-      _list_id = PJON<Strategy>::send_repeatedly(
-        PJON_BROADCAST,
-        this->tx.bus_id,
-        &request,
-        1,
-        OSPREY_LIST_IDS_TIME,
-        PJON<Strategy>::config | required_config,
-        0,
-        OSPREY_DYNAMIC_ADDRESSING_PORT
-      );
-    };
-
-    /* Confirm device ID insertion in list: */
-
-    bool confirm_id(uint8_t id, const uint8_t *mac) {
-      if(
-        PJONTools::id_equality(ids[id - 1].mac, mac, 6) &&
-        (ids[id - 1].state == OSPREY_INDEX_RESERVED)
-      ) {
-        add_id(id, mac);
-        return true;
-      }
-      return false;
+      this->clear();
+      this->load_ids();
+      reset_runtime_state();
+      list_ids();
     };
 
-    /* Count active slaves in buffer: */
+    /* Get the hash of the configuration transmitted to slaves: */
 
-    uint8_t count_slaves() {
-      uint8_t result = 0;
-      for(uint8_t i = 0; i < OSPREY_MAX_SLAVES; i++)
-        if(ids[i].state == OSPREY_INDEX_ASSIGNED) result++;
-      return result;
-    };
-
-    /* Empty a single element or the whole buffer: */
-
-    void delete_id_reference(uint8_t id = 0) {
-      if(!id) {
-        for(uint8_t i = 0; i < OSPREY_MAX_SLAVES; i++) {
-          PJONTools::copy_id(ids[i].mac, PJONTools::no_mac(), 6);
-          ids[i].state = false;
-          ids[i].registration = 0;
-        }
-      } else if(id > 0 && id < OSPREY_MAX_SLAVES) {
-        PJONTools::copy_id(ids[id - 1].mac, PJONTools::no_mac(), 6);
-        ids[id - 1].state = false;
-        ids[id - 1].registration = 0;
-      }
+    uint32_t configuration_hash() const {
+      return OSPREY_configuration_hash(configuration, configuration_length);
     };
 
     /* Master error handler: */
 
     void error(uint8_t code, uint16_t data) {
-      uint8_t id = PJON<Strategy>::packets[data].content[0];
-      _master_error(code, data, _custom_pointer);
-      if(
-        (code == PJON_CONNECTION_LOST) &&
-        (id != PJON_BROADCAST) &&
-        (id != PJON_NOT_ASSIGNED)
-      ) delete_id_reference(id);
+      if((code == PJON_CONNECTION_LOST) && probe_lost(data)) return;
+      if(code == PJON_CONNECTION_LOST) reply_lost(data);
+      handlers.error(code, data);
+      if(code == OSPREY_DEVICES_BUFFER_FULL)
+        OSPREY_TELEMETRY_COUNT(devices_buffer_full);
+      if(code == PJON_CONNECTION_LOST)
+        connection_lost(*this, PJON<Strategy>::packets[data].content[0]);
     };
 
     static void static_error_handler(uint8_t code, uint16_t data, void *cp) {
-      ((OSPREYMaster<Strategy>*)cp)->error(code, data);
+      ((OSPREYMaster *)cp)->error(code, data);
     };
 
     /* Filter addressing packets from receive callback: */
@@ -163,126 +165,65 @@ class OSPREYMaster : public PJON<Strategy> {
       uint16_t length,
       const PJON_Packet_Info &packet_info
     ) {
-      PJON_Packet_Info p_i;
-      memcpy(&p_i, &packet_info, sizeof(PJON_Packet_Info));
-      p_i.custom_pointer = _custom_pointer;
-      handle_addressing(packet_info, length);
-      _master_receiver(payload, length, p_i);
+      renew_lease(*this, packet_info);
+      probe_heard(packet_info.tx.id);
+      if(packet_info.port == OSPREY_DYNAMIC_ADDRESSING_PORT)
+        handle_addressing(payload, length, packet_info);
+      handlers.receiver(payload, length, packet_info);
+    };
+
+    /* Remove the assigned ids which lease expired (OSPREY_LEASE_TIME): */
+
+    void free_leases_expired() {
+      free_leases_expired(*this);
     };
 
     /* Remove reserved id which expired (Remove never confirmed ids): */
 
     void free_reserved_ids_expired() {
-      for(uint8_t i = 0; i < OSPREY_MAX_SLAVES; i++)
-        if(ids[i].state == OSPREY_INDEX_RESERVED) {
-          if(
-            (uint32_t)(PJON_MICROS() - ids[i].registration) <
-            OSPREY_ADDRESSING_TIMEOUT
-          ) continue;
-          else delete_id_reference(i + 1);
-        }
+      free_reserved_ids_expired(*this);
     };
 
     /* Handle addressing procedure if related: */
 
-    bool handle_addressing(PJON_Packet_Info info, uint16_t length) {
-      bool filter = false;
-      uint8_t overhead = PJON<Strategy>::packet_overhead(this->data[1]);
-      uint8_t CRC_overhead = (this->data[1] & PJON_CRC_BIT) ? 4 : 1;
-      uint8_t offset = overhead - CRC_overhead;
-
-      if(
-        (info.header & PJON_PORT_BIT) &&
-        (info.header & PJON_TX_INFO_BIT) &&
-        (info.header & PJON_CRC_BIT) &&
-        (info.header & PJON_MAC_BIT) &&
-        (info.port == OSPREY_DYNAMIC_ADDRESSING_PORT)
-      ) {
-        filter = true;
-        uint8_t request = this->data[offset];
-
-        if(request == OSPREY_ID_REQUEST) reserve_id(info.tx.mac);
-
-        if(request == OSPREY_ID_CONFIRM) {
-          if(!confirm_id(info.tx.id, info.tx.mac))
-            negate_id(info.tx.id, info.tx.mac);
-          else _found_slave(info.tx, this->data + offset + 1, length - 1);
-        }
-
-        if(request == OSPREY_ID_REFRESH) {
-          if(!add_id(info.tx.id, info.tx.mac))
-            negate_id(info.tx.id, info.tx.mac);
-          else _found_slave(info.tx, this->data + offset + 1, length - 1);
-        }
-
-        if(request == OSPREY_ID_NEGATE)
-          if(PJONTools::id_equality(info.tx.mac, ids[info.tx.id - 1].mac, 6))
-            delete_id_reference(info.tx.id);
-      }
-      return filter;
+    bool handle_addressing(
+      const uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &info
+    ) {
+      return handle_addressing(*this, this->tx.bus_id, payload, length, info);
     };
 
-    /* Get device index in buffer from MAC: */
+    /* Broadcast OSPREY_ID_LIST every OSPREY_LIST_IDS_TIME for the following
+       OSPREY_ADDRESSING_TIMEOUT, slaves answer with OSPREY_ID_REFRESH: */
 
-    uint8_t get_index_from_mac(const uint8_t *mac) {
-      for(uint8_t i = 0; i < OSPREY_MAX_SLAVES; i++)
-        if(PJONTools::id_equality(mac, ids[i].mac, 6)) return i;
-      return PJON_NOT_ASSIGNED;
+    void list_ids() {
+      _list_time = PJON_MICROS();
+      _list_last = _list_time - OSPREY_LIST_IDS_TIME;
+      _list_page = 0;
+      _listing = true;
     };
 
     /* Negates a device id: */
 
     void negate_id(uint8_t id, const uint8_t *mac) {
-      uint8_t response[1] = {OSPREY_ID_NEGATE};
-      PJON_Packet_Info info;
-      info.rx.id = id;
-      PJONTools::copy_id(info.rx.bus_id, this->tx.bus_id, 4);
-      info.header = PJON<Strategy>::config | required_config;
-      info.port = OSPREY_DYNAMIC_ADDRESSING_PORT;
-      PJONTools::copy_id(info.rx.mac, mac, 6);
-      PJON<Strategy>::send(info, response, 1);
-    };
-
-    /* Reserve a device id and wait for its confirmation: */
-
-    uint16_t reserve_index(const uint8_t *mac) {
-      uint8_t in = get_index_from_mac(mac);
-      for(
-        uint8_t i = (in != PJON_NOT_ASSIGNED) ? in : 0;
-        i < OSPREY_MAX_SLAVES;
-        i++
-      ) if((ids[i].state == OSPREY_INDEX_FREE) || (in == i)) {
-          PJONTools::copy_id(ids[i].mac, mac, 6);
-          ids[i].state = OSPREY_INDEX_RESERVED;
-          ids[i].registration = PJON_MICROS();
-          return i + 1;
-        }
-      error(OSPREY_DEVICES_BUFFER_FULL, OSPREY_MAX_SLAVES);
-      return OSPREY_DEVICES_BUFFER_FULL;
+      negate_id(this->tx.bus_id, id, mac);
+    };
+
+    /* Broadcast the configuration to the slaves connected, the slaves which
+       know a configuration with a different hash update it: */
+
+    void push_configuration() {
+      push_configuration(this->tx.bus_id);
     };
 
     /* Reserves a device id and transmits back a OSPREY_ID_REQUEST containing
-       the device id to the requester:
+       the device id to the requester (or adds it to the next OSPREY_ID_ASSIGN
+       if OSPREY_ID_BATCH is true):
     OSPREY_ID_REQUEST - DEVICE ID (the new reserved) */
 
     void reserve_id(const uint8_t *mac) {
-      uint8_t response[2 + OSPREY_CONFIGURATION_LENGTH];
-      uint16_t state = reserve_index(mac);
-      if(state == OSPREY_DEVICES_BUFFER_FULL) return;
-      if(state == PJON_FAIL)
-        return negate_id(PJON_NOT_ASSIGNED, mac);
-      response[0] = OSPREY_ID_REQUEST;
-      response[1] = (uint8_t)(state);
-      for(uint8_t i = 0; i < OSPREY_CONFIGURATION_LENGTH; i++)
-        response[2 + i] = configuration[i];
-
-      PJON_Packet_Info info;
-      info.rx.id = PJON_NOT_ASSIGNED;
-      PJONTools::copy_id(info.rx.bus_id, this->tx.bus_id, 4);
-      PJONTools::copy_id(info.rx.mac, mac, 6);
-      info.port = OSPREY_DYNAMIC_ADDRESSING_PORT;
-      info.header = PJON<Strategy>::config | required_config;
-      PJON<Strategy>::send(info, response, 2 + OSPREY_CONFIGURATION_LENGTH);
+      reserve_id(*this, this->tx.bus_id, mac);
     };
 
     /* Master receive function: */
@@ -308,14 +249,24 @@ class OSPREYMaster : public PJON<Strategy> {
       const PJON_Packet_Info &packet_info
     ) {
       (
-        (OSPREYMaster<Strategy>*)packet_info.custom_pointer
+        (OSPREYMaster *)packet_info.custom_pointer
       )->filter(payload, length, packet_info);
     };
 
+    /* Set the configuration transmitted to slaves, up to
+       ConfigurationLength bytes are used (call push_configuration to
+       transmit it to the slaves already connected): */
+
+    void set_configuration(const uint8_t *data, uint16_t length) {
+      if(length > ConfigurationLength) length = ConfigurationLength;
+      memcpy(configuration, data, length);
+      configuration_length = length;
+    };
+
     /* Set custom pointer: */
 
     void set_custom_pointer(void *p) {
-      _custom_pointer = p;
+      handlers.custom_pointer = p;
     };
 
     /* Set default configuration: */
@@ -325,47 +276,888 @@ class OSPREYMaster : public PJON<Strategy> {
       PJON<Strategy>::set_custom_pointer(this);
       PJON<Strategy>::set_error(static_error_handler);
       PJON<Strategy>::set_receiver(static_receiver_handler);
-      set_found_slave(OSPREY_dummy_found_slave);
-      delete_id_reference();
+      this->delete_id_reference();
     };
 
     /* Master receiver function setter: */
 
     void set_receiver(PJON_Receiver r) {
-      _master_receiver = r;
+      handlers.receiver_function = r;
     };
 
     /* Master error receiver function: */
 
     void set_error(PJON_Error e) {
-      _master_error = e;
+      handlers.error_function = e;
     };
 
     /* Set a function to be called each time a new slave is found */
 
     void set_found_slave(OSPREY_found_slave f) {
-      _found_slave = f;
+      handlers.found_slave_function = f;
+    };
+
+    /* Get a snapshot of the addressing telemetry (OSPREY_TELEMETRY): */
+
+    OSPREY_Telemetry telemetry() const {
+      #if OSPREY_TELEMETRY
+        return _telemetry;
+      #else
+        return OSPREY_Telemetry();
+      #endif
+    };
+
+    /* Reset the addressing telemetry: */
+
+    void reset_telemetry() {
+      #if OSPREY_TELEMETRY
+        _telemetry = OSPREY_Telemetry();
+      #endif
     };
 
     /* Master packet handling update: */
 
     uint8_t update() {
+      if(_listing) update_list();
+      update_joins();
+      update_batch();
+      free_reserved_ids_expired();
+      free_leases_expired();
+      uint8_t result = PJON<Strategy>::update();
+      release_packets();
+      update_replies();
+      update_probe();
+      return result;
+    };
+
+    /* Delay in microseconds until update() has timed work to do: the next
+       OSPREY_ID_LIST, the queued OSPREY_ID_REQUEST and responses, the
+       pending OSPREY_ID_ASSIGN, the next OSPREY_ID_PROBE, the expiry of
+       reserved ids and leases and the retries of the packets buffer. It is
+       0 if update() is due and OSPREY_NO_DEADLINE if nothing is scheduled.
+       The application can sleep until then or until a packet is received
+       (see runtime/OSPREYWait.h) instead of calling update() continuously: */
+
+    uint32_t update_delay() {
+      uint32_t now = PJON_MICROS();
+      uint32_t delay = OSPREY_packets_delay(*this, now);
+      if(_listing) delay = OSPREY_earliest(delay, list_delay(now));
+      #if OSPREY_JOIN_QUEUE_LENGTH
+        delay = OSPREY_earliest(delay, join_delay(now));
+      #endif
+      #if OSPREY_REPLY_QUEUE_LENGTH
+        if(replies_held() && (free_packets() > OSPREY_APPLICATION_PACKETS))
+          return 0;
+      #endif
+      #if OSPREY_PROBE_INTERVAL
+        if(this->count_slaves() && (_probe_packet == PJON_MAX_PACKETS))
+          delay = OSPREY_earliest(
+            delay,
+            OSPREY_remaining(_probe_time, OSPREY_PROBE_INTERVAL, now)
+          );
+      #endif
+      #if OSPREY_ID_BATCH
+        if(_batch_count)
+          delay = OSPREY_earliest(
+            delay,
+            OSPREY_remaining(_batch_time, OSPREY_ID_BATCH_TIME, now)
+          );
+      #endif
+      return OSPREY_earliest(delay, roster_delay(*this, now));
+    };
+
+  protected:
+    /* Reset the state of the listing, the batch, the queues and the probes
+       of the master, the devices buffer is not modified: */
+
+    void reset_runtime_state() {
+      uint32_t now = PJON_MICROS();
+      _list_id = PJON_MAX_PACKETS;
+      _list_last = now;
+      _list_page = 0;
+      _list_time = now;
+      _listing = false;
+      #if OSPREY_ID_BATCH
+        _batch_count = 0;
+        _batch_configured = true;
+        _batch_time = now;
+      #endif
+      #if OSPREY_REPLY_QUEUE_LENGTH
+        for(uint8_t i = 0; i < OSPREY_REPLY_QUEUE_LENGTH; i++) {
+          _replies[i].length = 0;
+          _replies[i].packet = PJON_MAX_PACKETS;
+          _replies[i].roster = NULL;
+        }
+      #endif
+      #if OSPREY_JOIN_QUEUE_LENGTH
+        _join_count = 0;
+        _join_head = 0;
+        _join_tokens = OSPREY_JOIN_BURST;
+        _join_refill = now;
+      #endif
+      #if OSPREY_PROBE_INTERVAL
+        memset(_probe_misses, 0, sizeof(_probe_misses));
+        _probe_id = 0;
+        _probe_packet = PJON_MAX_PACKETS;
+        _probe_time = now;
+      #endif
+    };
+
+    #if OSPREY_JOIN_QUEUE_LENGTH
+      /* OSPREY_ID_REQUEST waiting to be answered by update_joins(): */
+
+      struct Join {
+        OSPREYRoster<MaxSlaves> *roster;
+        uint8_t                  bus_id[4];
+        uint8_t                  mac[6];
+        uint8_t                  hash[4];
+        bool                     hashed;
+      };
+    #endif
+    #if OSPREY_REPLY_QUEUE_LENGTH
+      /* Addressing response to a MAC, held until the packets buffer has
+         space (length is not 0) or transmitted and still in the packets
+         buffer (packet is not PJON_MAX_PACKETS): */
+
+      struct Reply {
+        uint8_t                  bus_id[4];
+        uint8_t                  id;
+        uint8_t                  mac[6];
+        uint16_t                 length = 0;
+        uint16_t                 packet = PJON_MAX_PACKETS;
+        uint8_t                  payload[6 + ConfigurationLength];
+        // Devices buffer and id reserved by the response, if any
+        OSPREYRoster<MaxSlaves> *roster = NULL;
+        uint8_t                  reserved = 0;
+      };
+    #endif
+
+    uint16_t           _list_id = PJON_MAX_PACKETS;
+    uint32_t           _list_last = 0;
+    uint8_t            _list_page = 0;
+    uint32_t           _list_time = 0;
+    bool               _listing = false;
+    #if OSPREY_ID_BATCH
+      uint8_t          _batch[
+        6 + (OSPREY_ID_BATCH_LENGTH * 7) + ConfigurationLength
+      ];
+      uint8_t          _batch_bus_id[4];
+      bool             _batch_configured = true;
+      uint8_t          _batch_count = 0;
+      uint32_t         _batch_time = 0;
+    #endif
+    #if OSPREY_JOIN_QUEUE_LENGTH
+      Join             _joins[OSPREY_JOIN_QUEUE_LENGTH];
+      uint8_t          _join_count = 0;
+      uint8_t          _join_head = 0;
+      uint32_t         _join_refill = 0;
+      uint8_t          _join_tokens = OSPREY_JOIN_BURST;
+    #endif
+    #if OSPREY_REPLY_QUEUE_LENGTH
+      Reply            _replies[OSPREY_REPLY_QUEUE_LENGTH];
+    #endif
+    #if OSPREY_PROBE_INTERVAL
+      uint8_t          _probe_id = 0;
+      // Consecutive probes lost by each device id
+      uint8_t          _probe_misses[MaxSlaves] = {};
+      uint16_t         _probe_packet = PJON_MAX_PACKETS;
+      uint32_t         _probe_time = 0;
+    #endif
+    #if OSPREY_TELEMETRY
+      OSPREY_Telemetry _telemetry;
+    #endif
+
+    /* The following methods handle the addressing of the slaves of a bus
+       served by the master, passing its devices buffer and its bus id. */
+
+    /* Admit an OSPREY_ID_REQUEST, if OSPREY_JOIN_QUEUE_LENGTH is not 0 it is
+       queued and answered by update_joins(). A request of a MAC already
+       queued updates the queued one, if the queue is full the requester is
+       asked to retry when the queue is expected to be drained: */
+
+    void admit_id(
+      OSPREYRoster<MaxSlaves> &roster,
+      const uint8_t *bus_id,
+      const uint8_t *mac,
+      const uint8_t *hash
+    ) {
+      #if OSPREY_JOIN_QUEUE_LENGTH
+        Join *join = NULL;
+        for(uint8_t i = 0; (i < _join_count) && !join; i++) {
+          Join &queued = _joins[(_join_head + i) % OSPREY_JOIN_QUEUE_LENGTH];
+          if(
+            (queued.roster == &roster) &&
+            PJONTools::id_equality(queued.mac, mac, 6)
+          ) join = &queued;
+        }
+        if(!join) {
+          if(_join_count == OSPREY_JOIN_QUEUE_LENGTH)
+            return retry_id(bus_id, mac, join_time());
+          join = &_joins[
+            (_join_head + _join_count++) % OSPREY_JOIN_QUEUE_LENGTH
+          ];
+          join->roster = &roster;
+          PJONTools::copy_id(join->bus_id, bus_id, 4);
+          PJONTools::copy_id(join->mac, mac, 6);
+        }
+        join->hashed = (hash != NULL);
+        if(hash) memcpy(join->hash, hash, 4);
+      #else
+        reserve_id(roster, bus_id, mac, hash);
+      #endif
+    };
+
+    /* Remove the device id after a PJON_CONNECTION_LOST: */
+
+    void connection_lost(OSPREYRoster<MaxSlaves> &roster, uint8_t id) {
       if(
-        (_list_id != PJON_MAX_PACKETS) &&
-        (OSPREY_ADDRESSING_TIMEOUT < (uint32_t)(PJON_MICROS() - _list_time))
+        (id != PJON_BROADCAST) &&
+        (id <= MaxSlaves) &&
+        (roster.get_state(id) != OSPREY_INDEX_FREE)
       ) {
-        PJON<Strategy>::remove(_list_id);
-        _list_id = PJON_MAX_PACKETS;
+        OSPREY_TELEMETRY_COUNT(connection_lost);
+        roster.delete_id_reference(id);
       }
-      free_reserved_ids_expired();
-      return PJON<Strategy>::update();
+    };
+
+    /* Remove the assigned ids which lease expired: */
+
+    void free_leases_expired(OSPREYRoster<MaxSlaves> &roster) {
+      if(roster.free_lease_expired(PJON_MILLIS()))
+        OSPREY_TELEMETRY_COUNT(leases_expired);
+    };
+
+    /* Remove the reserved ids which expired: */
+
+    void free_reserved_ids_expired(OSPREYRoster<MaxSlaves> &roster) {
+      uint32_t now = PJON_MICROS();
+      while(roster.free_reserved_id_expired(now))
+        OSPREY_TELEMETRY_COUNT(reservations_expired);
+    };
+
+    /* Handle an addressing request of a slave of the bus: */
+
+    bool handle_addressing(
+      OSPREYRoster<MaxSlaves> &roster,
+      const uint8_t *bus_id,
+      const uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &info
+    ) {
+      bool filter = false;
+      if(
+        (info.port == OSPREY_DYNAMIC_ADDRESSING_PORT) &&
+        (
+          (info.header & OSPREY_ADDRESSING_HEADER) ==
+          OSPREY_ADDRESSING_HEADER
+        ) &&
+        length
+      ) {
+        filter = true;
+        uint8_t request = payload[0];
+
+        if(request == OSPREY_ID_REQUEST) {
+          OSPREY_TELEMETRY_COUNT(id_request);
+          admit_id(
+            roster,
+            bus_id,
+            info.tx.mac,
+            (length >= 5) ? payload + 1 : NULL
+          );
+        }
+
+        if(request == OSPREY_ID_CONFIRM) {
+          OSPREY_TELEMETRY_COUNT(id_confirm);
+          if(!roster.confirm_id(info.tx.id, info.tx.mac))
+            negate_id(bus_id, info.tx.id, info.tx.mac);
+          else {
+            OSPREY_TELEMETRY_LATENCY(roster.registration_age(info.tx.id));
+            handlers.found_slave(info.tx, payload + 1, length - 1);
+          }
+        }
+
+        if(request == OSPREY_ID_REFRESH) {
+          OSPREY_TELEMETRY_COUNT(id_refresh);
+          if(!roster.add_id(info.tx.id, info.tx.mac))
+            negate_id(bus_id, info.tx.id, info.tx.mac);
+          else handlers.found_slave(info.tx, payload + 1, length - 1);
+        }
+
+        if(request == OSPREY_ID_RENEW) {
+          OSPREY_TELEMETRY_COUNT(id_renew);
+          if(!roster.renew_lease(info.tx.id, info.tx.mac))
+            negate_id(bus_id, info.tx.id, info.tx.mac);
+        }
+
+        if(request == OSPREY_ID_NEGATE) OSPREY_TELEMETRY_COUNT(id_negate);
+
+        if(
+          (request == OSPREY_ID_NEGATE) &&
+          info.tx.id && (info.tx.id <= MaxSlaves) &&
+          PJONTools::id_equality(info.tx.mac, roster.ids[info.tx.id - 1].mac, 6)
+        ) roster.delete_id_reference(info.tx.id);
+      }
+      return filter;
+    };
+
+    /* Count the free slots of the packets buffer: */
+
+    uint16_t free_packets() const {
+      uint16_t count = 0;
+      for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++)
+        if(!PJON<Strategy>::packets[i].state) count++;
+      return count;
+    };
+
+    #if OSPREY_JOIN_QUEUE_LENGTH
+      /* Delay until update_joins() can answer a queued OSPREY_ID_REQUEST: */
+
+      uint32_t join_delay(uint32_t now) {
+        if(!_join_count) return OSPREY_NO_DEADLINE;
+        refill_joins(now);
+        if(!_join_tokens)
+          return OSPREY_remaining(_join_refill, OSPREY_JOIN_INTERVAL, now);
+        return (free_packets() > OSPREY_APPLICATION_PACKETS) ?
+          0 : OSPREY_NO_DEADLINE;
+      };
+
+      /* Time required to answer the queued requests (milliseconds): */
+
+      uint16_t join_time() const {
+        uint32_t time = (((uint32_t)_join_count * 1000) / OSPREY_JOIN_RATE) + 1;
+        return (time > 0xFFFF) ? 0xFFFF : (uint16_t)time;
+      };
+
+      /* Add a token every OSPREY_JOIN_INTERVAL, up to OSPREY_JOIN_BURST: */
+
+      void refill_joins(uint32_t now) {
+        uint32_t tokens = (uint32_t)(now - _join_refill) / OSPREY_JOIN_INTERVAL;
+        if((_join_tokens + tokens) >= OSPREY_JOIN_BURST) {
+          _join_tokens = OSPREY_JOIN_BURST;
+          _join_refill = now;
+        } else if(tokens) {
+          _join_tokens += tokens;
+          _join_refill += tokens * OSPREY_JOIN_INTERVAL;
+        }
+      };
+    #endif
+
+    /* Negates a device id of the bus: */
+
+    void negate_id(const uint8_t *bus_id, uint8_t id, const uint8_t *mac) {
+      uint8_t response[1] = {OSPREY_ID_NEGATE};
+      reply(bus_id, id, mac, response, 1);
+    };
+
+    /* Broadcast the configuration in a bus:
+       OSPREY_ID_CONFIGURATION - HASH - CONFIGURATION */
+
+    void push_configuration(const uint8_t *bus_id) {
+      uint8_t request[5 + ConfigurationLength];
+      request[0] = OSPREY_ID_CONFIGURATION;
+      OSPREY_write_hash(request + 1, configuration_hash());
+      memcpy(request + 5, configuration, configuration_length);
+      send_addressing(
+        bus_id,
+        PJON_BROADCAST,
+        NULL,
+        request,
+        5 + configuration_length
+      );
+    };
+
+    /* A packet was received from a device id of the master's bus, its
+       probes lost are forgotten: */
+
+    void probe_heard(uint8_t id) {
+      #if OSPREY_PROBE_INTERVAL
+        if(id && (id <= MaxSlaves)) _probe_misses[id - 1] = 0;
+      #else
+        (void)id;
+      #endif
+    };
+
+    /* Handle the PJON_CONNECTION_LOST of a packet, returns true if it was
+       an OSPREY_ID_PROBE. The device id is freed (and the error reported)
+       only after OSPREY_PROBE_MISSES consecutive probes lost: */
+
+    bool probe_lost(uint16_t packet) {
+      #if OSPREY_PROBE_INTERVAL
+        if((_probe_packet == PJON_MAX_PACKETS) || (packet != _probe_packet))
+          return false;
+        _probe_packet = PJON_MAX_PACKETS;
+        OSPREY_TELEMETRY_COUNT(probes_lost);
+        if(++_probe_misses[_probe_id - 1] < OSPREY_PROBE_MISSES) return true;
+        _probe_misses[_probe_id - 1] = 0;
+        handlers.error(PJON_CONNECTION_LOST, packet);
+        connection_lost(*this, _probe_id);
+        return true;
+      #else
+        (void)packet;
+        return false;
+      #endif
+    };
+
+    /* Renew the lease of the sender of a packet if it includes its MAC: */
+
+    void renew_lease(
+      OSPREYRoster<MaxSlaves> &roster,
+      const PJON_Packet_Info &info
+    ) {
+      #if OSPREY_LEASE_TIME
+        if(info.header & PJON_MAC_BIT)
+          roster.renew_lease(info.tx.id, info.tx.mac);
+      #else
+        (void)roster;
+        (void)info;
+      #endif
+    };
+
+    /* Reserves a device id of the bus and transmits it to the requester.
+       If the requester transmitted the hash of the configuration it knows
+       the response contains the master's hash and the configuration only if
+       the hashes do not match:
+       OSPREY_ID_REQUEST - DEVICE ID - CONFIGURATION
+       OSPREY_ID_REQUEST - DEVICE ID - HASH - CONFIGURATION (if changed) */
+
+    void reserve_id(
+      OSPREYRoster<MaxSlaves> &roster,
+      const uint8_t *bus_id,
+      const uint8_t *mac,
+      const uint8_t *hash = NULL
+    ) {
+      uint16_t state = roster.reserve_index(mac);
+      if(state == OSPREY_DEVICES_BUFFER_FULL) {
+        retry_id(bus_id, mac, OSPREY_RETRY_FULL_TIME);
+        return error(OSPREY_DEVICES_BUFFER_FULL, MaxSlaves);
+      }
+      #if OSPREY_ID_BATCH
+        batch_id(bus_id, (uint8_t)state, mac, hash);
+      #else
+        uint8_t response[6 + ConfigurationLength];
+        uint16_t length = 2;
+        response[0] = OSPREY_ID_REQUEST;
+        response[1] = (uint8_t)(state);
+        bool configured = false;
+        if(hash) {
+          uint32_t own = configuration_hash();
+          OSPREY_write_hash(response + 2, own);
+          configured = (OSPREY_read_hash(hash) == own);
+          length += 4;
+        }
+        if(!configured) {
+          memcpy(response + length, configuration, configuration_length);
+          length += configuration_length;
+        }
+        // Not transmitted, free the id so it does not wait for its expiry
+        if(!reply(bus_id, PJON_NOT_ASSIGNED, mac, response, length, &roster))
+          roster.delete_id_reference(state);
+      #endif
+    };
+
+    /* Transmit an addressing response to a device of the bus. Returns false
+       if it is dropped, the error call-back is then called with
+       PJON_PACKETS_BUFFER_FULL. If OSPREY_REPLY_QUEUE_LENGTH is 0 the
+       response is sent at once and dropped if the packets buffer is full.
+       Otherwise it replaces the response pending for the same MAC if any,
+       it is dropped only if OSPREY_REPLY_QUEUE_LENGTH responses to other
+       MACs are pending, else it is held while the packets buffer has no
+       more than OSPREY_APPLICATION_PACKETS free slots and true is returned.
+       If roster is passed the response carries the id reserved in it
+       (OSPREY_ID_REQUEST - DEVICE ID), the id is freed if the response
+       held is later replaced by another one or lost (PJON_CONNECTION_LOST),
+       so it does not wait for its expiry: */
+
+    bool reply(
+      const uint8_t *bus_id,
+      uint8_t id,
+      const uint8_t *mac,
+      const uint8_t *payload,
+      uint16_t length,
+      OSPREYRoster<MaxSlaves> *roster = NULL
+    ) {
+      #if OSPREY_REPLY_QUEUE_LENGTH
+        Reply *r = NULL;
+        for(uint8_t i = 0; i < OSPREY_REPLY_QUEUE_LENGTH; i++) {
+          Reply &pending = _replies[i];
+          if(
+            (pending.length || (pending.packet != PJON_MAX_PACKETS)) &&
+            PJONTools::id_equality(pending.mac, mac, 6) &&
+            PJONTools::id_equality(pending.bus_id, bus_id, 4)
+          ) {
+            r = &pending;
+            break;
+          }
+          if(!r && !pending.length && (pending.packet == PJON_MAX_PACKETS))
+            r = &pending;
+        }
+        if(!r) {
+          handlers.error(PJON_PACKETS_BUFFER_FULL, PJON_MAX_PACKETS);
+          return false;
+        }
+        uint8_t reserved = roster ? payload[1] : 0;
+        if( // Replace the older response, unless it is the same reservation
+          (r->length || (r->packet != PJON_MAX_PACKETS)) &&
+          ((r->roster != roster) || (r->reserved != reserved))
+        ) free_reply_reservation(*r);
+        if(r->packet != PJON_MAX_PACKETS) {
+          PJON<Strategy>::remove(r->packet);
+          r->packet = PJON_MAX_PACKETS;
+        }
+        PJONTools::copy_id(r->bus_id, bus_id, 4);
+        PJONTools::copy_id(r->mac, mac, 6);
+        r->id = id;
+        r->roster = roster;
+        r->reserved = reserved;
+        memcpy(r->payload, payload, length);
+        r->length = length;
+        transmit_reply(*r);
+        return true;
+      #else
+        (void)roster;
+        return send_addressing(bus_id, id, mac, payload, length) != PJON_FAIL;
+      #endif
+    };
+
+    /* Handle the PJON_CONNECTION_LOST of a packet, if it was a response of
+       the reply stage the id it reserved is freed: */
+
+    void reply_lost(uint16_t packet) {
+      #if OSPREY_REPLY_QUEUE_LENGTH
+        for(uint8_t i = 0; i < OSPREY_REPLY_QUEUE_LENGTH; i++)
+          if(_replies[i].packet == packet) {
+            _replies[i].packet = PJON_MAX_PACKETS;
+            free_reply_reservation(_replies[i]);
+          }
+      #else
+        (void)packet;
+      #endif
+    };
+
+    #if OSPREY_REPLY_QUEUE_LENGTH
+      /* Check if an addressing response is held: */
+
+      bool replies_held() const {
+        for(uint8_t i = 0; i < OSPREY_REPLY_QUEUE_LENGTH; i++)
+          if(_replies[i].length) return true;
+        return false;
+      };
+
+      /* Free the id reserved by a response not delivered, if it is still
+         reserved to the same MAC: */
+
+      void free_reply_reservation(Reply &r) {
+        if(
+          r.roster && r.reserved &&
+          (r.roster->get_state(r.reserved) == OSPREY_INDEX_RESERVED) &&
+          PJONTools::id_equality(r.roster->ids[r.reserved - 1].mac, r.mac, 6)
+        ) r.roster->delete_id_reference(r.reserved);
+        r.roster = NULL;
+      };
+
+      /* Move a held response in the packets buffer if it has space: */
+
+      void transmit_reply(Reply &r) {
+        if(free_packets() <= OSPREY_APPLICATION_PACKETS) return;
+        uint16_t result =
+          send_addressing(r.bus_id, r.id, r.mac, r.payload, r.length);
+        if(result == PJON_FAIL) return;
+        r.packet = result;
+        r.length = 0;
+      };
+    #endif
+
+    /* Ask a requester to transmit OSPREY_ID_REQUEST again after a delay in
+       milliseconds, if the packets buffer has space for it:
+       OSPREY_ID_RETRY - DELAY (16 bits) */
+
+    void retry_id(const uint8_t *bus_id, const uint8_t *mac, uint16_t delay) {
+      if(free_packets() <= OSPREY_APPLICATION_PACKETS) return;
+      uint8_t response[3] = {
+        OSPREY_ID_RETRY,
+        (uint8_t)(delay >> 8),
+        (uint8_t)(delay & 0xFF)
+      };
+      if(reply(bus_id, PJON_NOT_ASSIGNED, mac, response, 3))
+        OSPREY_TELEMETRY_COUNT(id_retry);
+    };
+
+    #if OSPREY_ID_BATCH
+      /* Add a reserved id to the pending OSPREY_ID_ASSIGN, it is broadcasted
+         when full, when a request is received from another bus or by
+         update_batch() after OSPREY_ID_BATCH_TIME. The configuration is
+         included if a requester does not know it: */
+
+      void batch_id(
+        const uint8_t *bus_id,
+        uint8_t id,
+        const uint8_t *mac,
+        const uint8_t *hash
+      ) {
+        if(_batch_count && !PJONTools::id_equality(bus_id, _batch_bus_id, 4))
+          send_batch();
+        if(!hash || (OSPREY_read_hash(hash) != configuration_hash()))
+          _batch_configured = false;
+        for(uint8_t i = 0; i < _batch_count; i++)
+          if(PJONTools::id_equality(_batch + 2 + (i * 7), mac, 6)) return;
+        if(!_batch_count) {
+          PJONTools::copy_id(_batch_bus_id, bus_id, 4);
+          _batch_time = PJON_MICROS();
+        }
+        uint8_t *entry = _batch + 2 + (_batch_count++ * 7);
+        PJONTools::copy_id(entry, mac, 6);
+        entry[6] = id;
+        if(_batch_count == OSPREY_ID_BATCH_LENGTH) send_batch();
+      };
+
+      /* Broadcast the pending OSPREY_ID_ASSIGN, slaves not receiving it
+         request an id again after OSPREY_ADDRESSING_TIMEOUT:
+         OSPREY_ID_ASSIGN - COUNT - (MAC - DEVICE ID) * COUNT - HASH -
+         CONFIGURATION (if a requester does not know it) */
+
+      void send_batch() {
+        uint16_t length = 2 + (_batch_count * 7);
+        _batch[0] = OSPREY_ID_ASSIGN;
+        _batch[1] = _batch_count;
+        OSPREY_write_hash(_batch + length, configuration_hash());
+        length += 4;
+        if(!_batch_configured) {
+          memcpy(_batch + length, configuration, configuration_length);
+          length += configuration_length;
+        }
+        send_addressing(_batch_bus_id, PJON_BROADCAST, NULL, _batch, length);
+        _batch_configured = true;
+        _batch_count = 0;
+      };
+    #endif
+
+    /* Answer the queued OSPREY_ID_REQUEST while a token is available and
+       the packets buffer has space for the response: */
+
+    void update_joins() {
+      #if OSPREY_JOIN_QUEUE_LENGTH
+        refill_joins(PJON_MICROS());
+        while(
+          _join_count && _join_tokens &&
+          (free_packets() > OSPREY_APPLICATION_PACKETS)
+        ) {
+          Join &join = _joins[_join_head];
+          _join_head = (_join_head + 1) % OSPREY_JOIN_QUEUE_LENGTH;
+          _join_count--;
+          _join_tokens--;
+          reserve_id(
+            *join.roster,
+            join.bus_id,
+            join.mac,
+            join.hashed ? join.hash : NULL
+          );
+        }
+      #endif
+    };
+
+    /* Transmit the held responses if the packets buffer has space: */
+
+    void update_replies() {
+      #if OSPREY_REPLY_QUEUE_LENGTH
+        for(uint8_t i = 0; i < OSPREY_REPLY_QUEUE_LENGTH; i++)
+          if(_replies[i].length) transmit_reply(_replies[i]);
+      #endif
+    };
+
+    /* Forget the responses and the OSPREY_ID_PROBE which left the packets
+       buffer (a probe acknowledged clears the probes lost of its id). It must
+       be called right after PJON<Strategy>::update(), before any packet is
+       sent, so that a slot freed is not reused before it is forgotten: */
+
+    void release_packets() {
+      #if OSPREY_REPLY_QUEUE_LENGTH
+        for(uint8_t i = 0; i < OSPREY_REPLY_QUEUE_LENGTH; i++)
+          if(
+            (_replies[i].packet != PJON_MAX_PACKETS) &&
+            !PJON<Strategy>::packets[_replies[i].packet].state
+          ) { // Delivered, the id reserved is kept
+            _replies[i].packet = PJON_MAX_PACKETS;
+            _replies[i].roster = NULL;
+          }
+      #endif
+      #if OSPREY_PROBE_INTERVAL
+        if(
+          (_probe_packet != PJON_MAX_PACKETS) &&
+          !PJON<Strategy>::packets[_probe_packet].state
+        ) {
+          _probe_packet = PJON_MAX_PACKETS;
+          _probe_misses[_probe_id - 1] = 0;
+        }
+      #endif
+    };
+
+    /* Transmit an OSPREY_ID_PROBE to the next assigned id every
+       OSPREY_PROBE_INTERVAL, one at a time and only if the packets buffer
+       has space for it, its acknowledgement proves the slave is alive:
+       OSPREY_ID_PROBE */
+
+    void update_probe() {
+      #if OSPREY_PROBE_INTERVAL
+        uint32_t now = PJON_MICROS();
+        if(
+          (_probe_packet != PJON_MAX_PACKETS) ||
+          !this->count_slaves() ||
+          ((uint32_t)(now - _probe_time) < OSPREY_PROBE_INTERVAL) ||
+          (free_packets() <= OSPREY_APPLICATION_PACKETS)
+        ) return;
+        for(uint8_t i = 0; i < MaxSlaves; i++) {
+          if(++_probe_id > MaxSlaves) _probe_id = 1;
+          if(this->get_state(_probe_id) == OSPREY_INDEX_ASSIGNED) break;
+        }
+        uint8_t request[1] = {OSPREY_ID_PROBE};
+        uint16_t result = send_addressing(
+          this->tx.bus_id,
+          _probe_id,
+          this->ids[_probe_id - 1].mac,
+          request,
+          1
+        );
+        _probe_time = now;
+        if(result == PJON_FAIL) return;
+        _probe_packet = result;
+        OSPREY_TELEMETRY_COUNT(id_probe);
+      #endif
+    };
+
+    /* Transmit the pending OSPREY_ID_ASSIGN after OSPREY_ID_BATCH_TIME: */
+
+    void update_batch() {
+      #if OSPREY_ID_BATCH
+        if(
+          _batch_count &&
+          ((uint32_t)(PJON_MICROS() - _batch_time) >= OSPREY_ID_BATCH_TIME)
+        ) send_batch();
+      #endif
+    };
+
+    /* Send an addressing packet to a device of the bus (to all if mac is
+       NULL). The master's bus id is replaced while the packet is composed so
+       it is transmitted by OSPREY_MASTER_ID of that bus: */
+
+    uint16_t send_addressing(
+      const uint8_t *bus_id,
+      uint8_t id,
+      const uint8_t *mac,
+      const uint8_t *payload,
+      uint16_t length
+    ) {
+      PJON_Packet_Info info;
+      info.rx.id = id;
+      PJONTools::copy_id(info.rx.bus_id, bus_id, 4);
+      if(mac) PJONTools::copy_id(info.rx.mac, mac, 6);
+      info.port = OSPREY_DYNAMIC_ADDRESSING_PORT;
+      info.header = PJON<Strategy>::config | required_config;
+      uint8_t own_bus_id[4];
+      PJONTools::copy_id(own_bus_id, this->tx.bus_id, 4);
+      PJONTools::copy_id(this->tx.bus_id, bus_id, 4);
+      uint16_t result = PJON<Strategy>::send(info, payload, length);
+      PJONTools::copy_id(this->tx.bus_id, own_bus_id, 4);
+      return result;
+    };
+
+    /* Broadcast the current OSPREY_ID_LIST page of the bus, the expected
+       responses are the ids of the page not known up to the highest id ever
+       assigned (all the ids not known if none was assigned):
+       OSPREY_ID_LIST - FIRST ID - IDS COUNT - BITMAP OF KNOWN IDS -
+       EXPECTED RESPONSES */
+
+    void send_list(OSPREYRoster<MaxSlaves> &roster, const uint8_t *bus_id) {
+      uint8_t request[4 + (OSPREY_ID_LIST_PAGE_LENGTH / 8)];
+      uint8_t length = 1;
+      request[0] = OSPREY_ID_LIST;
+      #if OSPREY_ID_LIST_ROSTER
+        uint8_t first = _list_page * OSPREY_ID_LIST_PAGE_LENGTH;
+        uint8_t count = MaxSlaves - first;
+        if(count > OSPREY_ID_LIST_PAGE_LENGTH)
+          count = OSPREY_ID_LIST_PAGE_LENGTH;
+        request[1] = first + 1;
+        request[2] = count;
+        length = 3 + roster.known_ids(first, count, request + 3);
+        uint8_t last = roster.highest_id();
+        if(!last || (last > (first + count))) last = first + count;
+        uint8_t expected = (last > first) ? last - first : 0;
+        for(uint8_t i = 3; i < length; i++)
+          for(uint8_t bits = request[i]; bits; bits &= bits - 1)
+            expected--;
+        request[length++] = expected;
+      #else
+        (void)roster;
+      #endif
+      _list_id =
+        send_addressing(bus_id, PJON_BROADCAST, NULL, request, length);
+      if(_list_id == PJON_FAIL) _list_id = PJON_MAX_PACKETS;
+      else OSPREY_TELEMETRY_COUNT(id_list);
+    };
+
+    /* Move to the next OSPREY_ID_LIST page: */
+
+    void next_list_page() {
+      #if OSPREY_ID_LIST_ROSTER
+        uint16_t next = (uint16_t)(_list_page + 1) * OSPREY_ID_LIST_PAGE_LENGTH;
+        if(next >= MaxSlaves) _list_page = 0;
+        else _list_page++;
+      #endif
+    };
+
+    /* Delay until the next OSPREY_ID_LIST or the end of the sweep: */
+
+    uint32_t list_delay(uint32_t now) {
+      uint32_t delay =
+        OSPREY_remaining(_list_time, OSPREY_ADDRESSING_TIMEOUT + 1, now);
+      if(list_pending()) return delay;
+      return OSPREY_earliest(
+        delay,
+        OSPREY_remaining(_list_last, OSPREY_LIST_IDS_TIME, now)
+      );
+    };
+
+    /* Check if the last OSPREY_ID_LIST is still in the packets buffer: */
+
+    bool list_pending() {
+      return (_list_id != PJON_MAX_PACKETS) &&
+        PJON<Strategy>::packets[_list_id].state;
+    };
+
+    /* Check if the OSPREY_ID_LIST sweep ended, or if the next OSPREY_ID_LIST
+       cannot be transmitted yet because the previous one is still pending: */
+
+    bool list_wait(uint32_t now) {
+      if((uint32_t)(now - _list_time) > OSPREY_ADDRESSING_TIMEOUT) {
+        _listing = false;
+        return true;
+      }
+      return list_pending();
+    };
+
+    /* Delay until a reserved id or a lease of the devices buffer expires: */
+
+    uint32_t roster_delay(OSPREYRoster<MaxSlaves> &roster, uint32_t now) {
+      uint32_t delay = roster.next_expiry(now);
+      #if OSPREY_LEASE_TIME
+        delay = OSPREY_earliest(
+          delay,
+          OSPREY_millis_delay(roster.next_lease_expiry(PJON_MILLIS()))
+        );
+      #endif
+      return delay;
     };
 
   private:
-    OSPREY_found_slave _found_slave;
-    uint16_t           _list_id = PJON_MAX_PACKETS;
-    uint32_t           _list_time;
-    void              *_custom_pointer;
-    PJON_Receiver      _master_receiver;
-    PJON_Error         _master_error;
+    /* Transmit the next OSPREY_ID_LIST broadcast if required: */
+
+    void update_list() {
+      uint32_t now = PJON_MICROS();
+      if(
+        list_wait(now) ||
+        ((uint32_t)(now - _list_last) < OSPREY_LIST_IDS_TIME)
+      ) return;
+      send_list(*this, this->tx.bus_id);
+      next_list_page();
+      _list_last = now;
+    };
 };
@@ -0,0 +1,256 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "OSPREYMaster.h"
+
+/* OSPREYMultiMaster serves the slaves of several buses sharing the same
+   medium (PJON shared mode), it receives in router mode and routes each
+   addressing request to the devices buffer of the sender's bus id. The
+   master's own bus id is served by the inherited devices buffer, up to
+   Buses additional bus ids can be served calling add_bus:
+   uint8_t bus_id[] = {0, 0, 0, 1};
+   uint8_t other_bus_id[] = {0, 0, 0, 2};
+   OSPREYMultiMaster<LocalUDP, 1> master(bus_id);
+   master.add_bus(other_bus_id); */
+
+template<
+  typename Strategy,
+  uint8_t Buses,
+  uint8_t MaxSlaves = OSPREY_MAX_SLAVES,
+  uint16_t ConfigurationLength = OSPREY_CONFIGURATION_LENGTH,
+  typename Handlers = OSPREYMasterCallbacks
+>
+class OSPREYMultiMaster :
+  public OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers> {
+  typedef OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers>
+    Master;
+
+  public:
+    OSPREYMultiMaster() : Master() {
+      set_default();
+    };
+
+    OSPREYMultiMaster(const uint8_t *bus) : Master(bus) {
+      set_default();
+    };
+
+    /* Serve an additional bus id, returns false if it is already served or
+       if Buses bus ids are already served: */
+
+    bool add_bus(const uint8_t *bus_id) {
+      if(roster(bus_id) || (_buses >= Buses)) return false;
+      PJONTools::copy_id(_bus_ids[_buses], bus_id, 4);
+      _rosters[_buses++].clear();
+      return true;
+    };
+
+    /* Master begin function, the devices buffers of all buses are restored
+       from their storage if set and the slaves not known are listed: */
+
+    void begin() {
+      for(uint8_t i = 0; i < _buses; i++) {
+        _rosters[i].clear();
+        _rosters[i].load_ids();
+      }
+      Master::begin();
+      _list_bus = 0;
+    };
+
+    /* Count the buses served (the master's own bus included): */
+
+    uint8_t count_buses() const {
+      return _buses + 1;
+    };
+
+    /* Multi master error handler, a device id is removed from the devices
+       buffer of the bus the packet was sent to. Only the slaves of the
+       master's own bus are probed (OSPREY_PROBE_INTERVAL): */
+
+    void error(uint8_t code, uint16_t data) {
+      if(code != PJON_CONNECTION_LOST) return Master::error(code, data);
+      if(this->probe_lost(data)) return;
+      this->reply_lost(data);
+      this->handlers.error(code, data);
+      PJON_Packet_Info info;
+      PJON<Strategy>::parse(PJON<Strategy>::packets[data].content, info);
+      OSPREYRoster<MaxSlaves> *r = roster(info.rx.bus_id);
+      if(r) this->connection_lost(*r, info.rx.id);
+    };
+
+    static void static_error_handler(uint8_t code, uint16_t data, void *cp) {
+      ((OSPREYMultiMaster *)cp)->error(code, data);
+    };
+
+    /* Filter the packets addressed to the master and route the addressing
+       requests to the devices buffer of the sender's bus. The packets sent
+       to the master of an additional bus are acknowledged here, PJON does
+       not acknowledge them in router mode (OSPREY_MULTI_MASTER_ACK): */
+
+    void filter(
+      uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &packet_info
+    ) {
+      if(
+        (packet_info.rx.id != OSPREY_MASTER_ID) &&
+        (packet_info.rx.id != PJON_BROADCAST)
+      ) return;
+      OSPREYRoster<MaxSlaves> *r = roster(packet_info.tx.bus_id);
+      if(!r) return;
+      #if OSPREY_MULTI_MASTER_ACK
+        if(
+          (packet_info.rx.id == OSPREY_MASTER_ID) &&
+          (packet_info.header & PJON_ACK_REQ_BIT) &&
+          roster(packet_info.rx.bus_id) &&
+          (roster(packet_info.rx.bus_id) != this)
+        ) PJON<Strategy>::strategy.send_response(PJON_ACK);
+      #endif
+      this->renew_lease(*r, packet_info);
+      if(r == this) this->probe_heard(packet_info.tx.id);
+      if(packet_info.port == OSPREY_DYNAMIC_ADDRESSING_PORT)
+        this->handle_addressing(
+          *r,
+          packet_info.tx.bus_id,
+          payload,
+          length,
+          packet_info
+        );
+      this->handlers.receiver(payload, length, packet_info);
+    };
+
+    /* Remove the assigned ids which lease expired in all buses: */
+
+    void free_leases_expired() {
+      Master::free_leases_expired();
+      for(uint8_t i = 0; i < _buses; i++)
+        Master::free_leases_expired(_rosters[i]);
+    };
+
+    /* Remove the reserved ids which expired in all buses: */
+
+    void free_reserved_ids_expired() {
+      Master::free_reserved_ids_expired();
+      for(uint8_t i = 0; i < _buses; i++)
+        Master::free_reserved_ids_expired(_rosters[i]);
+    };
+
+    /* Broadcast OSPREY_ID_LIST in all buses for the following
+       OSPREY_ADDRESSING_TIMEOUT: */
+
+    void list_ids() {
+      Master::list_ids();
+      _list_bus = 0;
+    };
+
+    /* Broadcast the configuration in all buses: */
+
+    void push_configuration() {
+      Master::push_configuration(this->tx.bus_id);
+      for(uint8_t i = 0; i < _buses; i++)
+        Master::push_configuration(_bus_ids[i]);
+    };
+
+    /* Get the devices buffer of a bus, NULL if the bus is not served: */
+
+    OSPREYRoster<MaxSlaves> *roster(const uint8_t *bus_id) {
+      if(PJONTools::id_equality(bus_id, this->tx.bus_id, 4)) return this;
+      for(uint8_t i = 0; i < _buses; i++)
+        if(PJONTools::id_equality(bus_id, _bus_ids[i], 4))
+          return &_rosters[i];
+      return NULL;
+    };
+
+    /* Static receiver hander: */
+
+    static void static_receiver_handler(
+      uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &packet_info
+    ) {
+      (
+        (OSPREYMultiMaster *)packet_info.custom_pointer
+      )->filter(payload, length, packet_info);
+    };
+
+    /* Set default configuration, packets are received in router mode: */
+
+    void set_default() {
+      Master::set_default();
+      PJON<Strategy>::set_error(static_error_handler);
+      PJON<Strategy>::set_receiver(static_receiver_handler);
+      PJON<Strategy>::set_router(true);
+    };
+
+    /* Multi master packet handling update: */
+
+    uint8_t update() {
+      if(this->_listing) update_list();
+      this->update_joins();
+      this->update_batch();
+      free_reserved_ids_expired();
+      free_leases_expired();
+      uint8_t result = PJON<Strategy>::update();
+      this->release_packets();
+      this->update_replies();
+      this->update_probe();
+      return result;
+    };
+
+    /* Delay until update() has timed work to do in any bus: */
+
+    uint32_t update_delay() {
+      uint32_t now = PJON_MICROS();
+      uint32_t delay = Master::update_delay();
+      if(this->_listing && _list_bus && !this->list_pending()) return 0;
+      for(uint8_t i = 0; i < _buses; i++)
+        delay = OSPREY_earliest(delay, this->roster_delay(_rosters[i], now));
+      return delay;
+    };
+
+  private:
+    uint8_t                 _bus_ids[Buses][4];
+    uint8_t                 _buses = 0;
+    uint8_t                 _list_bus = 0;
+    OSPREYRoster<MaxSlaves> _rosters[Buses];
+
+    /* Transmit the next OSPREY_ID_LIST broadcast if required. Each round
+       broadcasts the same page in all buses, one after the other as soon as
+       the previous is transmitted: */
+
+    void update_list() {
+      uint32_t now = PJON_MICROS();
+      if(
+        this->list_wait(now) || (
+          !_list_bus &&
+          ((uint32_t)(now - this->_list_last) < OSPREY_LIST_IDS_TIME)
+        )
+      ) return;
+      if(!_list_bus) {
+        this->send_list(*this, this->tx.bus_id);
+        this->_list_last = now;
+      } else this->send_list(_rosters[_list_bus - 1], _bus_ids[_list_bus - 1]);
+      if(++_list_bus > _buses) {
+        _list_bus = 0;
+        this->next_list_page();
+      }
+    };
+};
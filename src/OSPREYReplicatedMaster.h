@@ -0,0 +1,400 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+
+#pragma once
+#include "OSPREYMaster.h"
+
+/* OSPREYReplicatedMaster is a master with a hot-standby. Once the standby
+   master (OSPREY_STANDBY_ID) requested a full replica, the primary master
+   (OSPREY_MASTER_ID) replicates each change of its devices buffer to it
+   using the OSPREY_REPLICATION_PORT and, when idle, broadcasts a heartbeat
+   every OSPREY_HEARTBEAT_TIME. If the standby does not receive anything from
+   the primary for OSPREY_HEARTBEAT_TIMEOUT it takes over OSPREY_MASTER_ID
+   with the devices buffer replicated, slaves keep their ids and no
+   OSPREY_ID_LIST is required:
+   OSPREYReplicatedMaster<SoftwareBitBang> primary;
+   OSPREYReplicatedMaster<SoftwareBitBang> standby(OSPREY_ROLE_STANDBY);
+
+   Each take over increments the epoch of the master. A primary that
+   receives the heartbeat of another primary with a higher epoch steps down
+   and becomes the standby, one with a lower epoch is answered with a
+   heartbeat, so a primary that was only slow does not keep
+   OSPREY_MASTER_ID together with the standby that took over:
+   OSPREY_REPLICA_UPDATE - (DEVICE ID - STATE - MAC) * COUNT
+   OSPREY_REPLICA_HEARTBEAT - ASSIGNED IDS COUNT - RESERVED IDS COUNT -
+   EPOCH (16 bits)
+   OSPREY_REPLICA_SYNC (standby to primary, requests a full replica) */
+
+template<
+  typename Strategy,
+  uint8_t MaxSlaves = OSPREY_MAX_SLAVES,
+  uint16_t ConfigurationLength = OSPREY_CONFIGURATION_LENGTH,
+  typename Handlers = OSPREYMasterCallbacks
+>
+class OSPREYReplicatedMaster :
+  public OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers> {
+  typedef OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers>
+    Master;
+  static_assert(
+    MaxSlaves < OSPREY_STANDBY_ID,
+    "OSPREY_STANDBY_ID must not be a slave device id"
+  );
+
+  public:
+    OSPREYReplicatedMaster(uint8_t role = OSPREY_ROLE_PRIMARY) : Master() {
+      set_default();
+      set_role(role);
+    };
+
+    OSPREYReplicatedMaster(const uint8_t *bus, uint8_t role) : Master(bus) {
+      set_default();
+      set_role(role);
+    };
+
+    /* Master begin function, the primary announces itself with a heartbeat,
+       the standby master empties its devices buffer (or restores it from
+       storage) and requests a full replica: */
+
+    void begin() {
+      _replica_packet = PJON_MAX_PACKETS;
+      _replica_synced = false;
+      _primary_silent = false;
+      if(_role == OSPREY_ROLE_PRIMARY) {
+        _announce = true;
+        return Master::begin();
+      }
+      PJON<Strategy>::begin();
+      this->clear();
+      this->load_ids();
+      this->reset_runtime_state();
+      _heartbeat_time = PJON_MICROS();
+      send_replication(OSPREY_MASTER_ID, OSPREY_REPLICA_SYNC, NULL, 0);
+    };
+
+    /* Get the epoch of the master, incremented by each take over: */
+
+    uint16_t epoch() const {
+      return _epoch;
+    };
+
+    /* Replicated master error handler, if a replication packet is lost the
+       replication stops until the standby requests a full replica: */
+
+    void error(uint8_t code, uint16_t data) {
+      if(
+        (code == PJON_CONNECTION_LOST) &&
+        (_replica_packet != PJON_MAX_PACKETS) &&
+        (data == _replica_packet)
+      ) {
+        _replica_packet = PJON_MAX_PACKETS;
+        _replica_synced = false;
+        return this->handlers.error(code, data);
+      }
+      Master::error(code, data);
+    };
+
+    static void static_error_handler(uint8_t code, uint16_t data, void *cp) {
+      ((OSPREYReplicatedMaster *)cp)->error(code, data);
+    };
+
+    /* Filter the replication packets, the others are handled as usual: */
+
+    void filter(
+      uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &packet_info
+    ) {
+      if((packet_info.port != OSPREY_REPLICATION_PORT) || !length)
+        return Master::filter(payload, length, packet_info);
+      if(
+        (_role == OSPREY_ROLE_PRIMARY) &&
+        (packet_info.tx.id == OSPREY_STANDBY_ID) &&
+        (payload[0] == OSPREY_REPLICA_SYNC)
+      ) resync();
+      if( // Another primary, the one with the lower epoch steps down
+        (_role == OSPREY_ROLE_PRIMARY) &&
+        (packet_info.tx.id == OSPREY_MASTER_ID) &&
+        (payload[0] == OSPREY_REPLICA_HEARTBEAT) &&
+        (length >= 5)
+      ) {
+        int16_t newer = (int16_t)(read_epoch(payload) - _epoch);
+        if(newer > 0) step_down(read_epoch(payload));
+        else if(newer < 0) _announce = true;
+      }
+      if(
+        (_role == OSPREY_ROLE_STANDBY) &&
+        (packet_info.tx.id == OSPREY_MASTER_ID)
+      ) replicate(payload, length);
+    };
+
+    /* Get the role of the master (OSPREY_ROLE_PRIMARY or STANDBY): */
+
+    uint8_t role() const {
+      return _role;
+    };
+
+    /* Static receiver hander: */
+
+    static void static_receiver_handler(
+      uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &packet_info
+    ) {
+      (
+        (OSPREYReplicatedMaster *)packet_info.custom_pointer
+      )->filter(payload, length, packet_info);
+    };
+
+    /* Set default configuration: */
+
+    void set_default() {
+      Master::set_default();
+      PJON<Strategy>::set_error(static_error_handler);
+      PJON<Strategy>::set_receiver(static_receiver_handler);
+    };
+
+    /* Become the primary master using the devices buffer replicated, the
+       other masters are notified with a heartbeat of the new epoch: */
+
+    void take_over() {
+      set_role(OSPREY_ROLE_PRIMARY);
+      this->reset_runtime_state();
+      _primary_silent = false;
+      _epoch++;
+      _replica_synced = false;
+      _announce = true;
+    };
+
+    /* Replicated master packet handling update, the primary replicates its
+       devices buffer, the standby takes over if the primary is silent. The
+       take over is deferred to the following call, so the packets received
+       in between are handled before and a standby that was not updated in
+       time does not take over a primary still alive: */
+
+    uint8_t update() {
+      if(_role == OSPREY_ROLE_PRIMARY) {
+        update_replica();
+        return Master::update();
+      }
+      if(heartbeat_lost()) {
+        if(_primary_silent) take_over();
+        else _primary_silent = true;
+      }
+      return PJON<Strategy>::update();
+    };
+
+    /* Delay until update() has timed work to do, the replication and the
+       heartbeat timeout of the standby included: */
+
+    uint32_t update_delay() {
+      uint32_t now = PJON_MICROS();
+      if(_role == OSPREY_ROLE_STANDBY)
+        return OSPREY_earliest(
+          OSPREY_packets_delay(*this, now),
+          OSPREY_remaining(_heartbeat_time, OSPREY_HEARTBEAT_TIMEOUT, now)
+        );
+      uint32_t delay = Master::update_delay();
+      if(_replica_packet != PJON_MAX_PACKETS)
+        return PJON<Strategy>::packets[_replica_packet].state ? delay : 0;
+      if(_announce) return 0;
+      if(!_replica_synced) return delay;
+      if(_replica_version != this->version()) return 0;
+      return OSPREY_earliest(
+        delay,
+        OSPREY_remaining(_heartbeat_time, OSPREY_HEARTBEAT_TIME, now)
+      );
+    };
+
+  private:
+    bool     _announce = false;
+    uint16_t _epoch = 0;
+    uint32_t _heartbeat_time = 0;
+    bool     _primary_silent = false;
+    uint8_t  _replica_mac[MaxSlaves][6];
+    uint16_t _replica_packet = PJON_MAX_PACKETS;
+    uint8_t  _replica_state[MaxSlaves];
+    bool     _replica_synced = false;
+    uint16_t _replica_version = 0;
+    uint8_t  _role = OSPREY_ROLE_PRIMARY;
+
+    /* Check if the primary was silent for OSPREY_HEARTBEAT_TIMEOUT: */
+
+    bool heartbeat_lost() const {
+      return
+        (uint32_t)(PJON_MICROS() - _heartbeat_time) >=
+        OSPREY_HEARTBEAT_TIMEOUT;
+    };
+
+    /* Read the epoch of an OSPREY_REPLICA_HEARTBEAT: */
+
+    static uint16_t read_epoch(const uint8_t *payload) {
+      return ((uint16_t)payload[3] << 8) | payload[4];
+    };
+
+    /* Mark the whole devices buffer to be replicated again: */
+
+    void resync() {
+      memset(_replica_state, 0xFF, sizeof(_replica_state));
+      _replica_version = this->version() - 1;
+      _replica_synced = true;
+    };
+
+    /* Apply a replication packet received by the standby master, if the
+       heartbeat does not match the devices buffer a full replica is
+       requested: */
+
+    void replicate(const uint8_t *payload, uint16_t length) {
+      _heartbeat_time = PJON_MICROS();
+      _primary_silent = false;
+      if((payload[0] == OSPREY_REPLICA_HEARTBEAT) && (length >= 5))
+        _epoch = read_epoch(payload);
+      if(payload[0] == OSPREY_REPLICA_UPDATE)
+        for(uint16_t e = 1; (e + 8) <= length; e += 8)
+          this->set_id_reference(payload[e], payload[e + 1], payload + e + 2);
+      if(
+        (payload[0] == OSPREY_REPLICA_HEARTBEAT) && (length >= 3) && (
+          (payload[1] != this->count_slaves()) ||
+          (payload[2] != this->count_reserved())
+        )
+      ) send_replication(OSPREY_MASTER_ID, OSPREY_REPLICA_SYNC, NULL, 0);
+    };
+
+    /* Transmit a replication packet to the other master, or broadcast it: */
+
+    uint16_t send_replication(
+      uint8_t id,
+      uint8_t request,
+      const uint8_t *data,
+      uint16_t length
+    ) {
+      uint8_t packet[1 + (OSPREY_REPLICATION_PAGE_LENGTH * 8)];
+      packet[0] = request;
+      if(length) memcpy(packet + 1, data, length);
+      PJON_Packet_Info info;
+      info.rx.id = id;
+      PJONTools::copy_id(info.rx.bus_id, this->tx.bus_id, 4);
+      info.port = OSPREY_REPLICATION_PORT;
+      info.header =
+        PJON<Strategy>::config | PJON_TX_INFO_BIT | PJON_CRC_BIT |
+        PJON_PORT_BIT | ((id == PJON_BROADCAST) ? 0 : PJON_ACK_REQ_BIT);
+      return PJON<Strategy>::send(info, packet, length + 1);
+    };
+
+    /* Set the role and the device id of the master: */
+
+    void set_role(uint8_t role) {
+      _role = role;
+      this->set_id(
+        (role == OSPREY_ROLE_PRIMARY) ? OSPREY_MASTER_ID : OSPREY_STANDBY_ID
+      );
+    };
+
+    /* Become the standby of the primary with a higher epoch, the devices
+       buffer is replicated again from it: */
+
+    void step_down(uint16_t epoch) {
+      if(_replica_packet != PJON_MAX_PACKETS)
+        PJON<Strategy>::remove(_replica_packet);
+      _replica_packet = PJON_MAX_PACKETS;
+      _replica_synced = false;
+      _announce = false;
+      _epoch = epoch;
+      set_role(OSPREY_ROLE_STANDBY);
+      _heartbeat_time = PJON_MICROS();
+      send_replication(OSPREY_MASTER_ID, OSPREY_REPLICA_SYNC, NULL, 0);
+    };
+
+    /* Transmit the next change of the devices buffer to the standby or a
+       heartbeat, one replication packet at a time. Nothing is transmitted
+       until a standby requests a full replica (OSPREY_REPLICA_SYNC), or
+       after a replication packet is lost, except the heartbeat announcing
+       the master (after begin, a take over or the heartbeat of a primary
+       with a lower epoch): */
+
+    void update_replica() {
+      if(_replica_packet != PJON_MAX_PACKETS) {
+        if(PJON<Strategy>::packets[_replica_packet].state) return;
+        _replica_packet = PJON_MAX_PACKETS;
+      }
+      if(!_replica_synced && !_announce) return;
+      uint32_t now = PJON_MICROS();
+      if(_replica_synced && (_replica_version != this->version())) {
+        uint8_t data[OSPREY_REPLICATION_PAGE_LENGTH * 8];
+        uint16_t length = 0;
+        uint16_t version = this->version();
+        for(
+          uint8_t i = 0;
+          (i < MaxSlaves) && (length < sizeof(data));
+          i++
+        ) {
+          uint8_t state = this->get_state(i + 1);
+          if(
+            (_replica_state[i] == state) && (
+              (state == OSPREY_INDEX_FREE) ||
+              PJONTools::id_equality(_replica_mac[i], this->ids[i].mac, 6)
+            )
+          ) continue;
+          data[length] = i + 1;
+          data[length + 1] = state;
+          PJONTools::copy_id(data + length + 2, this->ids[i].mac, 6);
+          length += 8;
+        }
+        if(!length) _replica_version = version;
+        else {
+          uint16_t result = send_replication(
+            OSPREY_STANDBY_ID,
+            OSPREY_REPLICA_UPDATE,
+            data,
+            length
+          );
+          if(result == PJON_FAIL) return;
+          _replica_packet = result;
+          _heartbeat_time = now;
+          for(uint16_t e = 0; e < length; e += 8) {
+            _replica_state[data[e] - 1] = data[e + 1];
+            PJONTools::copy_id(_replica_mac[data[e] - 1], data + e + 2, 6);
+          }
+          return;
+        }
+      }
+      if(
+        !_announce &&
+        ((uint32_t)(now - _heartbeat_time) < OSPREY_HEARTBEAT_TIME)
+      ) return;
+      uint8_t heartbeat[4] = {
+        this->count_slaves(),
+        this->count_reserved(),
+        (uint8_t)(_epoch >> 8),
+        (uint8_t)(_epoch & 0xFF)
+      };
+      uint16_t result = send_replication(
+        PJON_BROADCAST,
+        OSPREY_REPLICA_HEARTBEAT,
+        heartbeat,
+        4
+      );
+      if(result == PJON_FAIL) return;
+      _replica_packet = result;
+      _heartbeat_time = now;
+      _announce = false;
+    };
+};
@@ -0,0 +1,144 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+
+#pragma once
+#include "OSPREYMaster.h"
+#include "OSPREYDirectory.h"
+
+/* OSPREYRootMaster is the master of a bus which also keeps the directory of
+   the slaves of the sub-masters (OSPREYSubMaster) of other buses, so each
+   MAC address can be located by bus id and device id. The directory
+   contains up to DirectoryLength slaves:
+   uint8_t bus_id[] = {0, 0, 0, 1};
+   OSPREYRootMaster<LocalUDP, 1000> root(bus_id); */
+
+template<
+  typename Strategy,
+  uint16_t DirectoryLength = OSPREY_DIRECTORY_LENGTH,
+  uint8_t MaxSlaves = OSPREY_MAX_SLAVES,
+  uint16_t ConfigurationLength = OSPREY_CONFIGURATION_LENGTH,
+  typename Handlers = OSPREYMasterCallbacks
+>
+class OSPREYRootMaster :
+  public OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers> {
+  typedef OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers>
+    Master;
+
+  public:
+    OSPREYDirectory<DirectoryLength> directory;
+
+    OSPREYRootMaster() : Master() {
+      set_default();
+    };
+
+    OSPREYRootMaster(const uint8_t *bus) : Master(bus) {
+      set_default();
+    };
+
+    /* Master begin function, the directory is emptied and filled again by
+       the sub-masters with their next report: */
+
+    void begin() {
+      directory.clear();
+      Master::begin();
+    };
+
+    /* Count the slaves of the bus and of the sub-masters: */
+
+    uint16_t count_all_slaves() const {
+      return this->count_slaves() + directory.count();
+    };
+
+    /* Filter the OSPREY_ID_DIRECTORY pages received from sub-masters: */
+
+    void filter(
+      uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &packet_info
+    ) {
+      if(
+        length && (payload[0] == OSPREY_ID_DIRECTORY) &&
+        (packet_info.port == OSPREY_DYNAMIC_ADDRESSING_PORT) &&
+        (packet_info.tx.id == OSPREY_MASTER_ID) &&
+        !PJONTools::id_equality(packet_info.tx.bus_id, this->tx.bus_id, 4) &&
+        !directory.update(packet_info.tx.bus_id, payload, length)
+      ) this->error(OSPREY_DIRECTORY_FULL, DirectoryLength);
+      Master::filter(payload, length, packet_info);
+    };
+
+    /* Locate a slave by MAC address in the bus or in the directory, returns
+       false if not found: */
+
+    bool locate(const uint8_t *mac, uint8_t *bus_id, uint8_t &id) {
+      uint8_t index = this->get_index_from_mac(mac);
+      if(
+        (index != PJON_NOT_ASSIGNED) &&
+        (this->get_state(index + 1) == OSPREY_INDEX_ASSIGNED)
+      ) {
+        PJONTools::copy_id(bus_id, this->tx.bus_id, 4);
+        id = index + 1;
+        return true;
+      }
+      uint16_t i = directory.find(mac);
+      if(i == DirectoryLength) return false;
+      PJONTools::copy_id(bus_id, directory.entries[i].bus_id, 4);
+      id = directory.entries[i].id;
+      return true;
+    };
+
+    /* Static receiver hander: */
+
+    static void static_receiver_handler(
+      uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &packet_info
+    ) {
+      (
+        (OSPREYRootMaster *)packet_info.custom_pointer
+      )->filter(payload, length, packet_info);
+    };
+
+    /* Set default configuration: */
+
+    void set_default() {
+      Master::set_default();
+      PJON<Strategy>::set_receiver(static_receiver_handler);
+    };
+
+    /* Root master packet handling update, the slaves of the sub-masters
+       which stopped reporting are removed from the directory: */
+
+    uint8_t update() {
+      directory.free_expired(PJON_MICROS());
+      return Master::update();
+    };
+
+    /* Delay until update() has timed work to do, the expiry of the
+       directory entries included: */
+
+    uint32_t update_delay() {
+      return OSPREY_earliest(
+        Master::update_delay(),
+        directory.next_expiry(PJON_MICROS())
+      );
+    };
+};
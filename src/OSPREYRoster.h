@@ -0,0 +1,794 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "OSPREYDeadline.h"
+#include "OSPREYStorage.h"
+
+/* MAC index length, power of 2 at least twice the number of slots: */
+
+constexpr uint16_t OSPREY_mac_index_length(
+  uint16_t slots,
+  uint16_t length = 16
+) {
+  return (length >= (2 * slots)) ?
+    length : OSPREY_mac_index_length(slots, length * 2);
+};
+
+/* Times saved in the devices buffer, if OSPREY_COMPACT_ROSTER is true they
+   are 16 bits ticks of 2^OSPREY_COMPACT_TICK_SHIFT microseconds or
+   milliseconds: */
+
+#if OSPREY_COMPACT_ROSTER
+  typedef uint16_t OSPREY_Tick;
+#else
+  typedef uint32_t OSPREY_Tick;
+#endif
+
+/* Reference to device, in the compact devices buffer its state is
+   tracked only by the bitmaps of the OSPREYRoster (see get_state): */
+struct Device_reference {
+  uint8_t  mac[6] = {0, 0, 0, 0, 0, 0};
+  #if !OSPREY_COMPACT_ROSTER
+    uint8_t  state  = 0;
+  #endif
+  OSPREY_Tick registration = 0;
+  #if OSPREY_LEASE_TIME
+    // Last renewal of the lease of the assigned id (milliseconds)
+    OSPREY_Tick lease = 0;
+  #endif
+};
+
+/* Event of the journal of a devices buffer, id is 0 if all the ids were
+   removed (the devices buffer was cleared): */
+struct OSPREY_Roster_Event {
+  uint32_t sequence = 0;
+  uint8_t  type = 0;
+  uint8_t  id = 0;
+  uint8_t  mac[6] = {0, 0, 0, 0, 0, 0};
+};
+
+/* Devices buffer of a master, it tracks the state of each device id using
+   bitmaps, counters, an expiry queue of the reserved ids and a MAC index.
+   The number of device ids (at most 253) defaults to OSPREY_MAX_SLAVES: */
+
+template<uint8_t MaxSlaves = OSPREY_MAX_SLAVES>
+class OSPREYRoster {
+  public:
+    Device_reference ids[MaxSlaves];
+
+    OSPREYRoster() {
+      clear();
+    };
+
+    /* Add a device reference, any other id reserved or assigned to the same
+       MAC is freed so that the MAC index has one entry for each MAC: */
+
+    bool add_id(uint8_t id, const uint8_t *mac) {
+      if(!id || (id > MaxSlaves)) return false;
+      if(PJONTools::id_equality(ids[id - 1].mac, mac, 6)) {
+        set_state(id - 1, OSPREY_INDEX_ASSIGNED);
+        record(OSPREY_JOURNAL_REFRESHED, id);
+        commit_ids();
+        return true;
+      }
+      if(index_state(id - 1) == OSPREY_INDEX_FREE) {
+        uint8_t index = get_index_from_mac(mac);
+        if(index != PJON_NOT_ASSIGNED)
+          remove_id(index + 1, OSPREY_JOURNAL_EVICTED);
+        PJONTools::copy_id(ids[id - 1].mac, mac, 6);
+        set_state(id - 1, OSPREY_INDEX_ASSIGNED);
+        index_insert(id - 1);
+        record(OSPREY_JOURNAL_ASSIGNED, id);
+        commit_ids();
+        return true;
+      }
+      return false;
+    };
+
+    /* Empty the devices buffer without updating the storage: */
+
+    void clear() {
+      for(uint8_t i = 0; i < MaxSlaves; i++) {
+        PJONTools::copy_id(ids[i].mac, PJONTools::no_mac(), 6);
+        #if !OSPREY_COMPACT_ROSTER
+          ids[i].state = OSPREY_INDEX_FREE;
+        #endif
+        ids[i].registration = 0;
+      }
+      for(uint8_t i = 0; i < bitmap_length; i++) {
+        _free[i] = 0xFFFFFFFF;
+        _assigned[i] = 0;
+      }
+      if(MaxSlaves % 32)
+        _free[bitmap_length - 1] =
+          ((uint32_t)1 << (MaxSlaves % 32)) - 1;
+      _assigned_count = 0;
+      _reserved_count = 0;
+      #if !OSPREY_COMPACT_ROSTER
+        _expiry_head = PJON_NOT_ASSIGNED;
+        _expiry_tail = PJON_NOT_ASSIGNED;
+      #endif
+      #if OSPREY_MAC_INDEX
+        memset(_mac_index, 0, sizeof(_mac_index));
+      #endif
+      _version++;
+      record(OSPREY_JOURNAL_EVICTED, 0);
+    };
+
+    /* Confirm device ID insertion in list: */
+
+    bool confirm_id(uint8_t id, const uint8_t *mac) {
+      if(!id || (id > MaxSlaves)) return false;
+      if(
+        PJONTools::id_equality(ids[id - 1].mac, mac, 6) &&
+        (index_state(id - 1) == OSPREY_INDEX_RESERVED)
+      ) {
+        set_state(id - 1, OSPREY_INDEX_ASSIGNED);
+        record(OSPREY_JOURNAL_ASSIGNED, id);
+        commit_ids();
+        return true;
+      }
+      return false;
+    };
+
+    /* Count free device ids: */
+
+    uint8_t count_free() const {
+      return MaxSlaves - _assigned_count - _reserved_count;
+    };
+
+    /* Count device ids reserved and waiting for confirmation: */
+
+    uint8_t count_reserved() const {
+      return _reserved_count;
+    };
+
+    /* Count active slaves in buffer: */
+
+    uint8_t count_slaves() const {
+      return _assigned_count;
+    };
+
+    /* Empty a single element or the whole buffer: */
+
+    void delete_id_reference(uint8_t id = 0) {
+      if(!id) {
+        clear();
+        save_ids();
+      } else {
+        remove_id(id, OSPREY_JOURNAL_EVICTED);
+        commit_ids();
+      }
+    };
+
+    /* Check the lease of the next assigned id (one for each call in round
+       robin order) and free it if expired, returns true if freed: */
+
+    bool free_lease_expired(uint32_t now) {
+      #if OSPREY_LEASE_TIME
+        if(++_lease_index >= MaxSlaves) _lease_index = 0;
+        if(
+          (index_state(_lease_index) != OSPREY_INDEX_ASSIGNED) ||
+          (elapsed(ids[_lease_index].lease, now) <= OSPREY_LEASE_TIME)
+        ) return false;
+        remove_id(_lease_index + 1, OSPREY_JOURNAL_EXPIRED);
+        commit_ids();
+        return true;
+      #else
+        (void)now;
+        return false;
+      #endif
+    };
+
+    /* Free the oldest reserved id if it expired, returns true if freed.
+       Reserved ids are queued in registration order and all share the same
+       timeout, so only the head of the queue is checked. The compact
+       devices buffer has no queue, the reserved ids are looked up in the
+       bitmaps and the first expired is freed: */
+
+    bool free_reserved_id_expired(uint32_t now) {
+      #if OSPREY_COMPACT_ROSTER
+        if(!_reserved_count) return false;
+        for(uint8_t w = 0; w < bitmap_length; w++)
+          for(
+            uint32_t reserved = ~(_free[w] | _assigned[w]) & valid_bits(w);
+            reserved;
+            reserved &= reserved - 1
+          ) {
+            uint8_t i = (w * 32) + first_set(reserved);
+            if(
+              elapsed(ids[i].registration, now) >= OSPREY_ADDRESSING_TIMEOUT
+            ) {
+              remove_id(i + 1, OSPREY_JOURNAL_EXPIRED);
+              return true;
+            }
+          }
+        return false;
+      #else
+        if(
+          (_expiry_head == PJON_NOT_ASSIGNED) ||
+          (
+            elapsed(ids[_expiry_head].registration, now) <
+            OSPREY_ADDRESSING_TIMEOUT
+          )
+        ) return false;
+        remove_id(_expiry_head + 1, OSPREY_JOURNAL_EXPIRED);
+        return true;
+      #endif
+    };
+
+    /* Get device index in buffer from MAC: */
+
+    uint8_t get_index_from_mac(const uint8_t *mac) {
+      #if OSPREY_MAC_INDEX
+        for(
+          uint16_t p = mac_hash(mac) & (mac_index_length - 1);
+          _mac_index[p];
+          p = (p + 1) & (mac_index_length - 1)
+        ) if(PJONTools::id_equality(mac, ids[_mac_index[p] - 1].mac, 6))
+            return _mac_index[p] - 1;
+      #else
+        for(uint8_t i = 0; i < MaxSlaves; i++)
+          if(
+            (index_state(i) != OSPREY_INDEX_FREE) &&
+            PJONTools::id_equality(mac, ids[i].mac, 6)
+          ) return i;
+      #endif
+      return PJON_NOT_ASSIGNED;
+    };
+
+    /* Get the sequence number of the next event of the journal: */
+
+    uint32_t journal_sequence() const {
+      #if OSPREY_JOURNAL_LENGTH
+        return _journal_sequence;
+      #else
+        return 0;
+      #endif
+    };
+
+    /* Get the state of a device id (OSPREY_INDEX_FREE, OSPREY_INDEX_RESERVED
+       or OSPREY_INDEX_ASSIGNED): */
+
+    uint8_t get_state(uint8_t id) const {
+      if(!id || (id > MaxSlaves)) return OSPREY_INDEX_FREE;
+      return index_state(id - 1);
+    };
+
+    /* Highest device id assigned since the devices buffer was created. It
+       is not reset by clear(), so it is kept when begin() is called again,
+       but it is kept in memory only: after a reboot it is rebuilt from the
+       ids restored from storage, without storage it is 0 until an id is
+       assigned (OSPREY_ID_LIST then expects all the ids not known): */
+
+    uint8_t highest_id() const {
+      return _highest_id;
+    };
+
+    /* Write in bitmap the assigned ids starting from the device index first
+       (multiple of 8), returns the number of bytes written: */
+
+    uint8_t known_ids(uint8_t first, uint8_t count, uint8_t *bitmap) const {
+      uint8_t length = (count + 7) / 8;
+      for(uint8_t i = 0; i < length; i++) {
+        uint8_t byte = (first / 8) + i;
+        bitmap[i] = (uint8_t)(_assigned[byte / 4] >> ((byte % 4) * 8));
+      }
+      return length;
+    };
+
+    /* Restore the devices buffer from storage. Restored ids are verified
+       lazily: they are reported as known in OSPREY_ID_LIST, they are updated
+       by the slaves' addressing requests and freed if a transmission to them
+       fails with PJON_CONNECTION_LOST: */
+
+    bool load_ids() {
+      uint8_t record[OSPREY_STORAGE_RECORD_LENGTH];
+      if(
+        !_storage || !_storage->read(_storage_address, record, 2) ||
+        (record[0] != OSPREY_STORAGE_VERSION) ||
+        (record[1] != MaxSlaves)
+      ) return save_ids();
+      OSPREYStorage *storage = _storage;
+      _storage = NULL; // Avoid to write back what is read
+      for(uint8_t i = 0; i < MaxSlaves; i++) {
+        if(!storage->read(record_address(i), record, sizeof(record))) break;
+        if(record[0] == OSPREY_INDEX_ASSIGNED) add_id(i + 1, record + 1);
+      }
+      _storage = storage;
+      return true;
+    };
+
+    /* Delay until the first reserved id expires (microseconds): */
+
+    uint32_t next_expiry(uint32_t now) const {
+      #if OSPREY_COMPACT_ROSTER
+        uint32_t delay = OSPREY_NO_DEADLINE;
+        if(!_reserved_count) return delay;
+        for(uint8_t w = 0; w < bitmap_length; w++)
+          for(
+            uint32_t reserved = ~(_free[w] | _assigned[w]) & valid_bits(w);
+            reserved;
+            reserved &= reserved - 1
+          ) delay = OSPREY_earliest(
+              delay,
+              expiry(ids[(w * 32) + first_set(reserved)].registration, now)
+            );
+        return delay;
+      #else
+        if(_expiry_head == PJON_NOT_ASSIGNED) return OSPREY_NO_DEADLINE;
+        return expiry(ids[_expiry_head].registration, now);
+      #endif
+    };
+
+    /* Delay until the first lease expires (milliseconds), the next call of
+       free_lease_expired checks the id which lease expires first: */
+
+    uint32_t next_lease_expiry(uint32_t now) {
+      uint32_t delay = OSPREY_NO_DEADLINE;
+      #if OSPREY_LEASE_TIME
+        for(uint8_t w = 0; w < bitmap_length; w++)
+          for(
+            uint32_t assigned = _assigned[w];
+            assigned;
+            assigned &= assigned - 1
+          ) {
+            uint8_t i = (w * 32) + first_set(assigned);
+            uint32_t elapsed_time = elapsed(ids[i].lease, now);
+            uint32_t remaining = (elapsed_time > OSPREY_LEASE_TIME) ?
+              0 : (OSPREY_LEASE_TIME - elapsed_time) + 1;
+            if(remaining >= delay) continue;
+            delay = remaining;
+            _lease_index = i ? i - 1 : MaxSlaves - 1;
+          }
+      #else
+        (void)now;
+      #endif
+      return delay;
+    };
+
+    /* Read the event of the journal with the sequence number passed, returns
+       false if it is not recorded yet. If it was overwritten sequence is
+       moved to the oldest event kept, the events in between are lost and the
+       devices buffer should be read again:
+       for(uint32_t s = last; roster.read_journal(s, event); last = ++s) */
+
+    bool read_journal(uint32_t &sequence, OSPREY_Roster_Event &event) const {
+      #if OSPREY_JOURNAL_LENGTH
+        if((int32_t)(sequence - _journal_sequence) >= 0) return false;
+        if((uint32_t)(_journal_sequence - sequence) > OSPREY_JOURNAL_LENGTH)
+          sequence = _journal_sequence - OSPREY_JOURNAL_LENGTH;
+        event = _journal[sequence & (OSPREY_JOURNAL_LENGTH - 1)];
+        return true;
+      #else
+        (void)sequence;
+        (void)event;
+        return false;
+      #endif
+    };
+
+    /* Time elapsed since the registration of a device id (microseconds): */
+
+    uint32_t registration_age(uint8_t id) const {
+      if(!id || (id > MaxSlaves)) return 0;
+      return elapsed(ids[id - 1].registration, PJON_MICROS());
+    };
+
+    /* Renew the lease of an id if it is assigned to the MAC passed: */
+
+    bool renew_lease(uint8_t id, const uint8_t *mac) {
+      if(
+        !id || (id > MaxSlaves) ||
+        (index_state(id - 1) != OSPREY_INDEX_ASSIGNED) ||
+        !PJONTools::id_equality(ids[id - 1].mac, mac, 6)
+      ) return false;
+      #if OSPREY_LEASE_TIME
+        ids[id - 1].lease = tick(PJON_MILLIS());
+      #endif
+      return true;
+    };
+
+    /* Reserve a device id and wait for its confirmation, returns the device
+       id or OSPREY_DEVICES_BUFFER_FULL: */
+
+    uint16_t reserve_index(const uint8_t *mac) {
+      uint8_t in = get_index_from_mac(mac);
+      if(in != PJON_NOT_ASSIGNED) {
+        set_state(in, OSPREY_INDEX_RESERVED);
+        ids[in].registration = tick(PJON_MICROS());
+        record(OSPREY_JOURNAL_RESERVED, in + 1);
+        commit_ids();
+        return in + 1;
+      }
+      for(uint8_t w = 0; w < bitmap_length; w++)
+        if(_free[w]) {
+          uint8_t i = (w * 32) + first_set(_free[w]);
+          PJONTools::copy_id(ids[i].mac, mac, 6);
+          set_state(i, OSPREY_INDEX_RESERVED);
+          ids[i].registration = tick(PJON_MICROS());
+          index_insert(i);
+          record(OSPREY_JOURNAL_RESERVED, i + 1);
+          return i + 1;
+        }
+      return OSPREY_DEVICES_BUFFER_FULL;
+    };
+
+    /* Save the whole devices buffer in storage: */
+
+    bool save_ids() {
+      if(!_storage) return false;
+      uint8_t header[2] = {OSPREY_STORAGE_VERSION, MaxSlaves};
+      if(!_storage->write(_storage_address, header, 2)) return false;
+      for(uint8_t i = 0; i < MaxSlaves; i++)
+        if(!write_id(i)) return false;
+      return _storage->flush();
+    };
+
+    /* Set the state and the MAC of a device id, any other id assigned or
+       reserved to the same MAC is freed: */
+
+    bool set_id_reference(uint8_t id, uint8_t state, const uint8_t *mac) {
+      if(!id || (id > MaxSlaves) || (state > OSPREY_INDEX_ASSIGNED))
+        return false;
+      if(
+        (state == OSPREY_INDEX_FREE) || (
+          (index_state(id - 1) != OSPREY_INDEX_FREE) &&
+          !PJONTools::id_equality(ids[id - 1].mac, mac, 6)
+        )
+      ) remove_id(id, OSPREY_JOURNAL_EVICTED);
+      if(state == OSPREY_INDEX_FREE) {
+        commit_ids();
+        return true;
+      }
+      uint8_t index = get_index_from_mac(mac);
+      if((index != PJON_NOT_ASSIGNED) && (index != (id - 1)))
+        remove_id(index + 1, OSPREY_JOURNAL_EVICTED);
+      if(index_state(id - 1) == OSPREY_INDEX_FREE) {
+        PJONTools::copy_id(ids[id - 1].mac, mac, 6);
+        set_state(id - 1, state);
+        index_insert(id - 1);
+      } else set_state(id - 1, state);
+      ids[id - 1].registration = tick(PJON_MICROS());
+      record(
+        (state == OSPREY_INDEX_ASSIGNED) ?
+          OSPREY_JOURNAL_ASSIGNED : OSPREY_JOURNAL_RESERVED,
+        id
+      );
+      commit_ids();
+      return true;
+    };
+
+    /* Set the storage where the devices buffer is saved each time a slave
+       is added or removed, address is the first byte used, the length used
+       is 2 + (MaxSlaves * OSPREY_STORAGE_RECORD_LENGTH) bytes: */
+
+    void set_storage(OSPREYStorage *storage, uint16_t address = 0) {
+      _storage = storage;
+      _storage_address = address;
+    };
+
+    /* Get the number of changes of the devices buffer, it is incremented
+       each time the state of an id changes and when the buffer is cleared: */
+
+    uint16_t version() const {
+      return _version;
+    };
+
+  private:
+    // Device ids are 1 - 253, PJON_NOT_ASSIGNED (255) marks empty links
+    static_assert(
+      MaxSlaves && (MaxSlaves <= 253),
+      "MaxSlaves must be between 1 and 253"
+    );
+    static const uint8_t bitmap_length = (MaxSlaves + 31) / 32;
+    #ifdef OSPREY_MAC_INDEX_LENGTH
+      static const uint16_t mac_index_length = OSPREY_MAC_INDEX_LENGTH;
+    #else
+      static const uint16_t mac_index_length =
+        OSPREY_mac_index_length(MaxSlaves);
+    #endif
+    #if OSPREY_MAC_INDEX
+      static_assert(
+        !(mac_index_length & (mac_index_length - 1)) &&
+        (mac_index_length > MaxSlaves),
+        "OSPREY_MAC_INDEX_LENGTH must be a power of 2 larger than MaxSlaves"
+      );
+    #endif
+    #if OSPREY_JOURNAL_LENGTH
+      static_assert(
+        !(OSPREY_JOURNAL_LENGTH & (OSPREY_JOURNAL_LENGTH - 1)),
+        "OSPREY_JOURNAL_LENGTH must be a power of 2"
+      );
+    #endif
+    #if OSPREY_COMPACT_ROSTER
+      static_assert(
+        OSPREY_COMPACT_TICK_SHIFT <= 16,
+        "OSPREY_COMPACT_TICK_SHIFT must be at most 16"
+      );
+    #endif
+    #if OSPREY_COMPACT_ROSTER && OSPREY_LEASE_TIME
+      static_assert(
+        OSPREY_LEASE_TIME < ((uint32_t)1 << (15 + OSPREY_COMPACT_TICK_SHIFT)),
+        "OSPREY_LEASE_TIME is too long for OSPREY_COMPACT_ROSTER"
+      );
+    #endif
+
+    // Free and assigned device ids bitmaps, reserved ids are in neither
+    uint32_t           _free[bitmap_length];
+    uint32_t           _assigned[bitmap_length];
+    uint8_t            _assigned_count = 0;
+    uint8_t            _highest_id = 0;
+    #if OSPREY_LEASE_TIME
+      uint8_t          _lease_index = 0;
+    #endif
+    uint8_t            _reserved_count = 0;
+    #if !OSPREY_COMPACT_ROSTER
+      // Reserved ids queue ordered by registration (expiry deadline)
+      uint8_t          _expiry_next[MaxSlaves];
+      uint8_t          _expiry_prev[MaxSlaves];
+      uint8_t          _expiry_head = PJON_NOT_ASSIGNED;
+      uint8_t          _expiry_tail = PJON_NOT_ASSIGNED;
+    #endif
+    #if OSPREY_JOURNAL_LENGTH
+      OSPREY_Roster_Event _journal[OSPREY_JOURNAL_LENGTH];
+      uint32_t         _journal_sequence = 0;
+    #endif
+    #if OSPREY_MAC_INDEX
+      // Device index + 1 in ids, 0 if the position is empty
+      uint8_t          _mac_index[mac_index_length];
+    #endif
+    OSPREYStorage     *_storage = NULL;
+    uint16_t           _storage_address = 0;
+    bool               _uncommitted = false;
+    uint16_t           _version = 0;
+
+    /* Add the device index to the MAC index: */
+
+    void index_insert(uint8_t index) {
+      #if OSPREY_MAC_INDEX
+        uint16_t p = mac_hash(ids[index].mac) & (mac_index_length - 1);
+        while(_mac_index[p]) p = (p + 1) & (mac_index_length - 1);
+        _mac_index[p] = index + 1;
+      #else
+        (void)index;
+      #endif
+    };
+
+    /* Remove the device index from the MAC index shifting back the entries
+       of its probe sequence so that no tombstone is required: */
+
+    void index_remove(uint8_t index) {
+      #if OSPREY_MAC_INDEX
+        const uint16_t mask = mac_index_length - 1;
+        uint16_t p = mac_hash(ids[index].mac) & mask;
+        while(_mac_index[p] && (_mac_index[p] != index + 1)) p = (p + 1) & mask;
+        if(!_mac_index[p]) return;
+        for(uint16_t n = (p + 1) & mask; _mac_index[n]; n = (n + 1) & mask) {
+          uint16_t h = mac_hash(ids[_mac_index[n] - 1].mac) & mask;
+          // Move back the entry if its home position is not within (p, n]
+          if(((n - h) & mask) >= ((n - p) & mask)) {
+            _mac_index[p] = _mac_index[n];
+            p = n;
+          }
+        }
+        _mac_index[p] = 0;
+      #else
+        (void)index;
+      #endif
+    };
+
+    /* Time elapsed since a time saved, in the same unit of now: */
+
+    static uint32_t elapsed(OSPREY_Tick since, uint32_t now) {
+      #if OSPREY_COMPACT_ROSTER
+        return (uint32_t)(OSPREY_Tick)(tick(now) - since) <<
+          OSPREY_COMPACT_TICK_SHIFT;
+      #else
+        return now - since;
+      #endif
+    };
+
+    /* Delay until a reservation registered at the time passed expires: */
+
+    static uint32_t expiry(OSPREY_Tick registration, uint32_t now) {
+      uint32_t elapsed_time = elapsed(registration, now);
+      return (elapsed_time >= OSPREY_ADDRESSING_TIMEOUT) ?
+        0 : OSPREY_ADDRESSING_TIMEOUT - elapsed_time;
+    };
+
+    #if !OSPREY_COMPACT_ROSTER
+      /* Append a reserved device index to the expiry queue: */
+
+      void expiry_append(uint8_t index) {
+        _expiry_next[index] = PJON_NOT_ASSIGNED;
+        _expiry_prev[index] = _expiry_tail;
+        if(_expiry_tail != PJON_NOT_ASSIGNED)
+          _expiry_next[_expiry_tail] = index;
+        else _expiry_head = index;
+        _expiry_tail = index;
+      };
+
+      /* Remove a device index from the expiry queue: */
+
+      void expiry_remove(uint8_t index) {
+        if(_expiry_prev[index] != PJON_NOT_ASSIGNED)
+          _expiry_next[_expiry_prev[index]] = _expiry_next[index];
+        else _expiry_head = _expiry_next[index];
+        if(_expiry_next[index] != PJON_NOT_ASSIGNED)
+          _expiry_prev[_expiry_next[index]] = _expiry_prev[index];
+        else _expiry_tail = _expiry_prev[index];
+      };
+    #endif
+
+    /* Index of the least significant bit set (value must not be 0): */
+
+    static uint8_t first_set(uint32_t value) {
+      #if defined(__GNUC__)
+        return __builtin_ctzl(value);
+      #else
+        uint8_t i = 0;
+        while(!(value & 1)) {
+          value >>= 1;
+          i++;
+        }
+        return i;
+      #endif
+    };
+
+    /* State of a device index, the compact devices buffer derives it from
+       the bitmaps (reserved ids are neither free nor assigned): */
+
+    uint8_t index_state(uint8_t index) const {
+      #if OSPREY_COMPACT_ROSTER
+        uint32_t bit = (uint32_t)1 << (index % 32);
+        if(_free[index / 32] & bit) return OSPREY_INDEX_FREE;
+        if(_assigned[index / 32] & bit) return OSPREY_INDEX_ASSIGNED;
+        return OSPREY_INDEX_RESERVED;
+      #else
+        return ids[index].state;
+      #endif
+    };
+
+    /* FNV-1a hash of a MAC address: */
+
+    static uint16_t mac_hash(const uint8_t *mac) {
+      uint32_t h = 2166136261UL;
+      for(uint8_t i = 0; i < 6; i++) {
+        h ^= mac[i];
+        h *= 16777619UL;
+      }
+      return (uint16_t)(h ^ (h >> 16));
+    };
+
+    /* Storage address of a device reference: */
+
+    uint16_t record_address(uint8_t index) const {
+      return _storage_address + 2 + (index * OSPREY_STORAGE_RECORD_LENGTH);
+    };
+
+    /* Commit the device references written since the last commit, each
+       public method changing the devices buffer calls it once at its end: */
+
+    void commit_ids() {
+      if(!_uncommitted) return;
+      _uncommitted = false;
+      _storage->flush();
+    };
+
+    /* Write a device reference, reserved ids are saved as free: */
+
+    bool write_id(uint8_t index) {
+      if(!_storage) return false;
+      uint8_t record[OSPREY_STORAGE_RECORD_LENGTH];
+      record[0] = (index_state(index) == OSPREY_INDEX_ASSIGNED) ?
+        OSPREY_INDEX_ASSIGNED : OSPREY_INDEX_FREE;
+      PJONTools::copy_id(record + 1, ids[index].mac, 6);
+      return _storage->write(record_address(index), record, sizeof(record));
+    };
+
+    /* Record an event of a device id in the journal: */
+
+    void record(uint8_t type, uint8_t id) {
+      #if OSPREY_JOURNAL_LENGTH
+        OSPREY_Roster_Event &event =
+          _journal[_journal_sequence & (OSPREY_JOURNAL_LENGTH - 1)];
+        event.sequence = _journal_sequence++;
+        event.type = type;
+        event.id = id;
+        PJONTools::copy_id(
+          event.mac,
+          id ? ids[id - 1].mac : PJONTools::no_mac(),
+          6
+        );
+      #else
+        (void)type;
+        (void)id;
+      #endif
+    };
+
+    /* Free a device id recording the reason (evicted or expired): */
+
+    void remove_id(uint8_t id, uint8_t type) {
+      if(!id || (id > MaxSlaves)) return;
+      if(index_state(id - 1) != OSPREY_INDEX_FREE) {
+        record(type, id);
+        index_remove(id - 1);
+      }
+      PJONTools::copy_id(ids[id - 1].mac, PJONTools::no_mac(), 6);
+      set_state(id - 1, OSPREY_INDEX_FREE);
+      ids[id - 1].registration = 0;
+    };
+
+    /* Time to be saved in the devices buffer: */
+
+    static OSPREY_Tick tick(uint32_t time) {
+      #if OSPREY_COMPACT_ROSTER
+        return (OSPREY_Tick)(time >> OSPREY_COMPACT_TICK_SHIFT);
+      #else
+        return time;
+      #endif
+    };
+
+    /* Bits of the ids existing in a word of the bitmaps: */
+
+    static uint32_t valid_bits(uint8_t word) {
+      if((word < (bitmap_length - 1)) || !(MaxSlaves % 32)) return 0xFFFFFFFF;
+      return ((uint32_t)1 << (MaxSlaves % 32)) - 1;
+    };
+
+    /* Set the state of a device index updating bitmaps, counters, the
+       expiry queue (a renewed reservation is moved to the queue's tail), the
+       lease of assigned ids and the storage if the device is assigned or
+       unassigned: */
+
+    void set_state(uint8_t index, uint8_t state) {
+      uint8_t previous = index_state(index);
+      #if !OSPREY_COMPACT_ROSTER
+        if(previous == OSPREY_INDEX_RESERVED) expiry_remove(index);
+        if(state == OSPREY_INDEX_RESERVED) expiry_append(index);
+      #endif
+      #if OSPREY_LEASE_TIME
+        if(state == OSPREY_INDEX_ASSIGNED)
+          ids[index].lease = tick(PJON_MILLIS());
+      #endif
+      if(previous == state) return;
+      _version++;
+      uint32_t bit = (uint32_t)1 << (index % 32);
+      if(previous == OSPREY_INDEX_RESERVED) _reserved_count--;
+      if(previous == OSPREY_INDEX_ASSIGNED) _assigned_count--;
+      if(state == OSPREY_INDEX_RESERVED) _reserved_count++;
+      if(state == OSPREY_INDEX_ASSIGNED) _assigned_count++;
+      if((state == OSPREY_INDEX_ASSIGNED) && (index >= _highest_id))
+        _highest_id = index + 1;
+      if(state == OSPREY_INDEX_FREE) _free[index / 32] |= bit;
+      else _free[index / 32] &= ~bit;
+      if(state == OSPREY_INDEX_ASSIGNED) _assigned[index / 32] |= bit;
+      else _assigned[index / 32] &= ~bit;
+      #if !OSPREY_COMPACT_ROSTER
+        ids[index].state = state;
+      #endif
+      if(
+        ((previous == OSPREY_INDEX_ASSIGNED) ||
+        (state == OSPREY_INDEX_ASSIGNED)) && write_id(index)
+      ) _uncommitted = true;
+    };
+};
@@ -20,16 +20,71 @@
           \*/
 
 #pragma once
-#include "OSPREYDefines.h"
+#include "OSPREYConfiguration.h"
+#include "OSPREYDeadline.h"
+#include "OSPREYStorage.h"
+#include "OSPREYTelemetry.h"
 
 typedef void (* OSPREY_Connected)(const uint8_t *configuration, uint16_t length);
 static void OSPREY_dummy_connected(const uint8_t *, uint16_t) {};
 
-template<typename Strategy>
+typedef void (* OSPREY_State_Change)(uint8_t state);
+static void OSPREY_dummy_state_change(uint8_t) {};
+
+/* Default OSPREYSlave handlers policy, calls the functions set at runtime
+   passing the application's custom pointer. Any class defining the same
+   connected, error, receiver and state_change methods can be passed as the
+   Handlers template parameter to have the handlers called directly: */
+
+struct OSPREYSlaveCallbacks {
+  void               *custom_pointer = NULL;
+  OSPREY_Connected    connected_function = OSPREY_dummy_connected;
+  PJON_Error          error_function = PJON_dummy_error_handler;
+  PJON_Receiver       receiver_function = PJON_dummy_receiver_handler;
+  OSPREY_State_Change state_change_function = OSPREY_dummy_state_change;
+
+  void connected(const uint8_t *configuration, uint16_t length) {
+    connected_function(configuration, length);
+  };
+
+  void error(uint8_t code, uint16_t data) {
+    error_function(code, data, custom_pointer);
+  };
+
+  /* The receiver function is called with a copy of the packet info that
+     contains the application's custom pointer: */
+
+  void receiver(
+    uint8_t *payload,
+    uint16_t length,
+    const PJON_Packet_Info &packet_info
+  ) {
+    PJON_Packet_Info info = packet_info;
+    info.custom_pointer = custom_pointer;
+    receiver_function(payload, length, info);
+  };
+
+  void state_change(uint8_t state) {
+    state_change_function(state);
+  };
+};
+
+/* The configuration length and the handlers policy default to
+   OSPREY_CONFIGURATION_LENGTH and to the function pointers set at runtime:
+   OSPREYSlave<SoftwareBitBang> slave;
+   OSPREYSlave<SoftwareBitBang, 5, MyHandlers> configured_slave; */
+
+template<
+  typename Strategy,
+  uint16_t ConfigurationLength = OSPREY_CONFIGURATION_LENGTH,
+  typename Handlers = OSPREYSlaveCallbacks
+>
 class OSPREYSlave : public PJON<Strategy> {
   public:
     bool connected = false;
-    uint8_t configuration[OSPREY_CONFIGURATION_LENGTH];
+    uint8_t configuration[ConfigurationLength];
+    uint16_t configuration_length = ConfigurationLength;
+    Handlers handlers;
     uint8_t required_config =
       PJON_ACK_REQ_BIT | PJON_TX_INFO_BIT | PJON_CRC_BIT |
       PJON_PORT_BIT | PJON_MAC_BIT
@@ -65,58 +120,70 @@ class OSPREYSlave : public PJON<Strategy> {
       set_default();
     };
 
-    /* Acquire id in master-slave configuration: */
+    /* Get the state of the addressing procedure: */
+
+    uint8_t addressing_state() const {
+      return _state;
+    };
+
+    /* Acquire id in master-slave configuration. The request is transmitted
+       by update(), the procedure ends calling the connected call-back or the
+       error call-back with OSPREY_ID_ACQUISITION_FAIL: */
 
     bool request_id() {
+      if(_state == OSPREY_SLAVE_RELEASING) return false;
       connected = false;
-      uint8_t response[1] = {OSPREY_ID_REQUEST};
-      if(
-        this->send_packet_blocking(
-          OSPREY_MASTER_ID,
-          this->tx.bus_id,
-          response,
-          1,
-          this->config | required_config,
-          0,
-          OSPREY_DYNAMIC_ADDRESSING_PORT
-        ) == PJON_ACK
-      ) return true;
-      error(OSPREY_ID_ACQUISITION_FAIL, OSPREY_ID_REQUEST);
-      return false;
-    };
-
-    /* Begin function to be called in setup: */
+      _joining = 0;
+      schedule(OSPREY_ID_REQUEST, backoff());
+      set_state(OSPREY_SLAVE_REQUESTING);
+      _join_time = PJON_MICROS();
+      return true;
+    };
+
+    /* Begin function to be called in setup. If the storage is set the
+       identity saved is restored and, if it contains an id, the slave
+       rejoins transmitting OSPREY_ID_REFRESH: */
 
     void begin() {
       PJON<Strategy>::begin();
+      if(load_identity()) {
+        if(this->tx.id != PJON_NOT_ASSIGNED) rejoin();
+        return;
+      }
       if(PJONTools::id_equality(this->tx.mac, PJONTools::no_mac(), 6))
         generate_mac();
+      save_identity();
     };
 
-    /* Release device id (Master-slave only): */
+    /* Release device id (Master-slave only), the id is released by update()
+       when the master acknowledges the OSPREY_ID_NEGATE request: */
 
     bool discard_device_id() {
-      uint8_t request[1] = {OSPREY_ID_NEGATE};
-      if(this->send_packet_blocking(
-        OSPREY_MASTER_ID,
-        this->bus_id,
-        request,
-        1,
-        this->config | required_config,
-        0,
-        OSPREY_DYNAMIC_ADDRESSING_PORT
-      ) == PJON_ACK) {
-        this->_device_id = PJON_NOT_ASSIGNED;
-        return true;
-      }
-      error(OSPREY_ID_ACQUISITION_FAIL, OSPREY_ID_NEGATE);
-      return false;
+      if(this->tx.id == PJON_NOT_ASSIGNED) return false;
+      _joining = 0;
+      schedule(OSPREY_ID_NEGATE, 0);
+      set_state(OSPREY_SLAVE_RELEASING);
+      return true;
     };
 
-    /* Error callback: */
+    /* Error callback, the failure of a pending addressing packet is reported
+       as OSPREY_ID_ACQUISITION_FAIL: */
 
     void error(uint8_t code, uint16_t data) {
-      _slave_error(code, data, _custom_pointer);
+      #if OSPREY_LEASE_TIME
+        if((code == PJON_CONNECTION_LOST) && (data == _lease_packet))
+          _lease_packet = PJON_MAX_PACKETS;
+      #endif
+      if(
+        (code == PJON_CONNECTION_LOST) &&
+        (_packet != PJON_MAX_PACKETS) &&
+        (data == _packet)
+      ) {
+        uint8_t request = _packet_request;
+        _packet = PJON_MAX_PACKETS;
+        return request_failed(request);
+      }
+      handlers.error(code, data);
     };
 
     /* Filter incoming addressing packets callback: */
@@ -126,11 +193,9 @@ class OSPREYSlave : public PJON<Strategy> {
       uint16_t length,
       const PJON_Packet_Info &packet_info
     ) {
-      PJON_Packet_Info p_i;
-      memcpy(&p_i, &packet_info, sizeof(PJON_Packet_Info));
-      p_i.custom_pointer = _custom_pointer;
-      handle_addressing(packet_info, length);
-      _slave_receiver(payload, length, p_i);
+      if(packet_info.port == OSPREY_DYNAMIC_ADDRESSING_PORT)
+        handle_addressing(payload, length, packet_info);
+      handlers.receiver(payload, length, packet_info);
     };
 
     /* Generate a new device rid: */
@@ -144,80 +209,137 @@ class OSPREYSlave : public PJON<Strategy> {
         ;
     };
 
-    /* Handle dynamic addressing requests and responses: */
+    /* Handle dynamic addressing requests and responses, transmissions are
+       scheduled and then dispatched by update(): */
 
-    void handle_addressing(PJON_Packet_Info info, uint16_t length) {
+    void handle_addressing(
+      const uint8_t *payload,
+      uint16_t length,
+      const PJON_Packet_Info &info
+    ) {
       if( // Handle master-slave dynamic addressing
-        (info.header & PJON_PORT_BIT) &&
-        (info.header & PJON_TX_INFO_BIT) &&
-        (info.header & PJON_CRC_BIT) &&
-        (info.header & PJON_MAC_BIT) &&
         (info.port == OSPREY_DYNAMIC_ADDRESSING_PORT) &&
-        (info.tx.id == OSPREY_MASTER_ID)
+        (
+          (info.header & OSPREY_ADDRESSING_HEADER) ==
+          OSPREY_ADDRESSING_HEADER
+        ) &&
+        (info.tx.id == OSPREY_MASTER_ID) &&
+        length
       ) {
-        uint8_t overhead =
-          this->packet_overhead(info.header);
-        uint8_t CRC_overhead =
-          (info.header & PJON_CRC_BIT) ? 4 : 1;
-        uint8_t offset = overhead - CRC_overhead;
-        char response[1 + OSPREY_CONFIGURATION_LENGTH];
-
-        if(!connected && (this->data[offset] == OSPREY_ID_REQUEST)) {
-          this->set_id(this->data[offset + 1]);
-          response[0] = OSPREY_ID_CONFIRM;
-          memcpy(response + 1, configuration, OSPREY_CONFIGURATION_LENGTH);
-          _connected(this->data + offset + 2, length - 2);
-          if(this->send_packet_blocking(
-            OSPREY_MASTER_ID,
-            this->tx.bus_id,
-            response,
-            1 + OSPREY_CONFIGURATION_LENGTH,
-            this->config | required_config,
-            0,
-            OSPREY_DYNAMIC_ADDRESSING_PORT
-          ) != PJON_ACK) {
-            this->set_id(PJON_NOT_ASSIGNED);
-            connected = false;
-            error(OSPREY_ID_ACQUISITION_FAIL, OSPREY_ID_CONFIRM);
-          } else connected = true;
+        uint8_t request = payload[0];
+        if(request == OSPREY_ID_REQUEST) OSPREY_TELEMETRY_COUNT(id_request);
+        if(request == OSPREY_ID_NEGATE) OSPREY_TELEMETRY_COUNT(id_negate);
+        if(request == OSPREY_ID_LIST) OSPREY_TELEMETRY_COUNT(id_list);
+
+        if(
+          (_state == OSPREY_SLAVE_REQUESTING) &&
+          (request == OSPREY_ID_REQUEST) &&
+          (length >= 2)
+        ) assign(
+          payload[1],
+          payload + 2,
+          length - 2,
+          OSPREY_CONFIGURATION_HASH
+        );
+
+        if( // Master is busy, request again after the delay it suggested
+          (_state == OSPREY_SLAVE_REQUESTING) &&
+          (request == OSPREY_ID_RETRY) &&
+          (length >= 3)
+        ) {
+          OSPREY_TELEMETRY_COUNT(id_retry);
+          uint32_t delay = ((uint32_t)payload[1] << 8) | payload[2];
+          // Spread the requests of the slaves told to retry together
+          delay += (uint32_t)PJON_RANDOM((delay / 2) + 1);
+          schedule(OSPREY_ID_REQUEST, delay * 1000);
         }
 
-        if(connected && (this->data[offset] == OSPREY_ID_NEGATE)) {
+        if( // Look for the own MAC in the ids assigned in batch
+          (_state == OSPREY_SLAVE_REQUESTING) &&
+          (request == OSPREY_ID_ASSIGN) &&
+          (length >= 2) &&
+          (length >= (2 + (payload[1] * 7)))
+        ) {
+          uint16_t offset = 2 + (payload[1] * 7);
+          for(const uint8_t *e = payload + 2; e < (payload + offset); e += 7)
+            if(PJONTools::id_equality(e, this->tx.mac, 6)) {
+              assign(e[6], payload + offset, length - offset, true);
+              break;
+            }
+        }
+
+        if(
+          (this->tx.id != PJON_NOT_ASSIGNED) &&
+          (_state != OSPREY_SLAVE_REQUESTING) &&
+          (request == OSPREY_ID_NEGATE)
+        ) {
           this->set_id(PJON_NOT_ASSIGNED);
           connected = false;
+          cancel();
+          save_identity();
+          // The id confirmed or restored is not available, request a new one
+          if(_joining) request_failed(_joining);
+          else set_state(OSPREY_SLAVE_IDLE);
+        }
+
+        if( // Configuration pushed by master, handled only if changed
+          (connected || (_joining && (_state == OSPREY_SLAVE_CONNECTED))) &&
+          (request == OSPREY_ID_CONFIGURATION) &&
+          (length >= 5) &&
+          (OSPREY_read_hash(payload + 1) != _master_configuration_hash)
+        ) {
+          configure(payload + 1, length - 1, true);
+          save_identity();
+          if(connected)
+            handlers.connected(
+              _master_configuration,
+              _master_configuration_length
+            );
         }
 
-        if(this->data[offset] == OSPREY_ID_LIST) {
-          if(connected) {
-            if(
+        if( // Without a page a response is sent at most once in the time gate
+          (request == OSPREY_ID_LIST) &&
+          listed(payload, length) && (
+            paged(payload, length) ||
+            (
               (uint32_t)(PJON_MICROS() - _last_request_time) >
               (OSPREY_ADDRESSING_TIMEOUT * 2)
-            ) {
-              PJON_DELAY(PJON_RANDOM(OSPREY_COLLISION_DELAY));
-              _last_request_time = PJON_MICROS();
-              response[0] = OSPREY_ID_REFRESH;
-              memcpy(response + 1, configuration, OSPREY_CONFIGURATION_LENGTH);
-              this->send_packet_blocking(
-                OSPREY_MASTER_ID,
-                this->tx.bus_id,
-                response,
-                1 + OSPREY_CONFIGURATION_LENGTH,
-                this->config | required_config,
-                0,
-                OSPREY_DYNAMIC_ADDRESSING_PORT
-              );
-            }
-          } else if(
-            (uint32_t)(PJON_MICROS() - _last_request_time) >
-            (OSPREY_ADDRESSING_TIMEOUT * 2)
-          ) {
-            _last_request_time = PJON_MICROS();
-            request_id();
-          }
+            )
+          )
+        ) {
+          // Answer after a random delay to avoid collisions
+          uint32_t delay = response_delay(payload, length);
+          if(_state == OSPREY_SLAVE_CONNECTED) {
+            schedule(OSPREY_ID_REFRESH, delay);
+            set_state(OSPREY_SLAVE_REFRESHING);
+          } else if((_state == OSPREY_SLAVE_IDLE) && request_id())
+            schedule(OSPREY_ID_REQUEST, delay);
         }
       }
     };
 
+    /* Check if a OSPREY_ID_LIST requires a response. If it contains a page of
+       the id space the slave responds only if its id is part of the page and
+       it is not marked as known by master:
+       OSPREY_ID_LIST - FIRST ID - IDS COUNT - BITMAP OF KNOWN IDS */
+
+    bool listed(const uint8_t *request, uint16_t length) {
+      if(!paged(request, length) || (this->tx.id == PJON_NOT_ASSIGNED))
+        return true;
+      if(
+        (this->tx.id < request[1]) ||
+        (this->tx.id >= (uint16_t)(request[1] + request[2]))
+      ) return false;
+      uint8_t bit = this->tx.id - request[1];
+      return !(request[3 + (bit / 8)] & (1 << (bit % 8)));
+    };
+
+    /* Check if a OSPREY_ID_LIST contains a page of the id space: */
+
+    static bool paged(const uint8_t *request, uint16_t length) {
+      return (length >= 3) && (length >= (3 + ((request[2] + 7) / 8)));
+    };
+
     /* Slave receive function: */
 
     uint16_t receive() {
@@ -233,10 +355,69 @@ class OSPREYSlave : public PJON<Strategy> {
       return PJON_FAIL;
     };
 
+    /* Set the configuration transmitted to master, up to
+       ConfigurationLength bytes are used: */
+
+    void set_configuration(const uint8_t *data, uint16_t length) {
+      if(length > ConfigurationLength) length = ConfigurationLength;
+      memcpy(configuration, data, length);
+      configuration_length = length;
+    };
+
+    #if OSPREY_LEASE_TIME
+      using PJON<Strategy>::send;
+
+      /* Send a packet, if it is a packet to master that renews the lease
+         its index is tracked by track_lease_packet(): */
+
+      uint16_t send(
+        uint8_t id,
+        const void *payload,
+        uint16_t length,
+        uint8_t header = PJON_NO_HEADER,
+        uint16_t packet_id = 0,
+        uint16_t port = PJON_BROADCAST
+      ) {
+        return track_lease_packet(
+          PJON<Strategy>::send(id, payload, length, header, packet_id, port)
+        );
+      };
+
+      uint16_t send(
+        uint8_t id,
+        const uint8_t *bus_id,
+        const void *payload,
+        uint16_t length,
+        uint8_t header = PJON_NO_HEADER,
+        uint16_t packet_id = 0,
+        uint16_t port = PJON_BROADCAST
+      ) {
+        return track_lease_packet(
+          PJON<Strategy>::send(
+            id,
+            bus_id,
+            payload,
+            length,
+            header,
+            packet_id,
+            port
+          )
+        );
+      };
+
+      uint16_t send(
+        const PJON_Packet_Info &info,
+        const void *payload,
+        uint16_t length
+      ) {
+        return track_lease_packet(PJON<Strategy>::send(info, payload, length));
+      };
+    #endif
+
     /* Set custom pointer: */
 
     void set_custom_pointer(void *p) {
-      _custom_pointer = p;
+      handlers.custom_pointer = p;
     }
 
     /* Set default configuration: */
@@ -246,25 +427,38 @@ class OSPREYSlave : public PJON<Strategy> {
       PJON<Strategy>::set_custom_pointer(this);
       PJON<Strategy>::set_receiver(static_receiver_handler);
       PJON<Strategy>::set_error(static_error_handler);
-      set_connected(OSPREY_dummy_connected);
     };
 
     /* Slave receiver function setter: */
 
     void set_receiver(PJON_Receiver r) {
-      _slave_receiver = r;
+      handlers.receiver_function = r;
     };
 
     /* Slave error receiver function: */
 
     void set_error(PJON_Error e) {
-      _slave_error = e;
+      handlers.error_function = e;
     };
 
     /* Set function called when a slave connects to a master: */
 
     void set_connected(OSPREY_Connected c) {
-      _connected = c;
+      handlers.connected_function = c;
+    };
+
+    /* Set function called when the addressing state changes: */
+
+    void set_state_change(OSPREY_State_Change s) {
+      handlers.state_change_function = s;
+    };
+
+    /* Set the storage where the slave saves its identity (MAC, bus id, id
+       and master's configuration), to be called before begin: */
+
+    void set_storage(OSPREYStorage *storage, uint16_t address = 0) {
+      _storage = storage;
+      _storage_address = address;
     };
 
     /* Static receiver hander: */
@@ -275,7 +469,7 @@ class OSPREYSlave : public PJON<Strategy> {
       const PJON_Packet_Info &packet_info
     ) {
       (
-        (OSPREYSlave<Strategy>*)packet_info.custom_pointer
+        (OSPREYSlave *)packet_info.custom_pointer
       )->filter(payload, length, packet_info);
     };
 
@@ -286,20 +480,441 @@ class OSPREYSlave : public PJON<Strategy> {
       uint16_t data,
       void *custom_pointer
     ) {
-      ((OSPREYSlave<Strategy>*)custom_pointer)->error(code, data);
+      ((OSPREYSlave *)custom_pointer)->error(code, data);
+    };
+
+    /* Get a snapshot of the addressing telemetry (OSPREY_TELEMETRY): */
+
+    OSPREY_Telemetry telemetry() const {
+      #if OSPREY_TELEMETRY
+        return _telemetry;
+      #else
+        return OSPREY_Telemetry();
+      #endif
     };
 
-    /* Slave packet handling update: */
+    /* Reset the addressing telemetry: */
+
+    void reset_telemetry() {
+      #if OSPREY_TELEMETRY
+        _telemetry = OSPREY_Telemetry();
+      #endif
+    };
+
+    /* Slave packet handling update, advances the addressing procedure: */
 
     uint8_t update() {
-      return PJON<Strategy>::update();
+      if(
+        _action &&
+        ((uint32_t)(PJON_MICROS() - _action_time) >= _action_delay)
+      ) dispatch();
+      uint8_t result = PJON<Strategy>::update();
+      #if OSPREY_LEASE_TIME
+        if( // Acknowledged by master, that renewed the lease receiving it
+          (_lease_packet != PJON_MAX_PACKETS) &&
+          !PJON<Strategy>::packets[_lease_packet].state
+        ) {
+          _lease_packet = PJON_MAX_PACKETS;
+          if(_state == OSPREY_SLAVE_CONNECTED) _lease_time = PJON_MILLIS();
+        }
+      #endif
+      if(
+        (_packet != PJON_MAX_PACKETS) &&
+        !PJON<Strategy>::packets[_packet].state
+      ) {
+        _packet = PJON_MAX_PACKETS;
+        request_delivered(_packet_request);
+      }
+      if(
+        (_state == OSPREY_SLAVE_REQUESTING) &&
+        !_action && (_packet == PJON_MAX_PACKETS) &&
+        (
+          (uint32_t)(PJON_MICROS() - _last_request_time) >
+          OSPREY_ADDRESSING_TIMEOUT
+        )
+      ) request_failed(OSPREY_ID_REQUEST);
+      if( // The id confirmed or restored was not negated, the join is complete
+        _joining && (_state == OSPREY_SLAVE_CONNECTED) &&
+        ((uint32_t)(PJON_MICROS() - _join_time) > OSPREY_ADDRESSING_TIMEOUT)
+      ) joined();
+      #if OSPREY_LEASE_TIME
+        if( // Renew the lease after half of its duration
+          (_state == OSPREY_SLAVE_CONNECTED) &&
+          !_action && (_packet == PJON_MAX_PACKETS) &&
+          ((uint32_t)(PJON_MILLIS() - _lease_time) >= (OSPREY_LEASE_TIME / 2))
+        ) schedule(OSPREY_ID_RENEW, 0);
+      #endif
+      return result;
+    };
+
+    /* Delay in microseconds until update() has timed work to do: the
+       scheduled addressing request, the timeout of the pending one or of
+       the join, the renewal of the lease and the retries of the packets
+       buffer. It is 0 if update() is due and OSPREY_NO_DEADLINE if nothing
+       is scheduled: */
+
+    uint32_t update_delay() {
+      uint32_t now = PJON_MICROS();
+      uint32_t delay = OSPREY_packets_delay(*this, now);
+      if(_action)
+        return OSPREY_earliest(
+          delay,
+          OSPREY_remaining(_action_time, _action_delay, now)
+        );
+      if(_packet != PJON_MAX_PACKETS)
+        return PJON<Strategy>::packets[_packet].state ? delay : 0;
+      if(_state == OSPREY_SLAVE_REQUESTING)
+        delay = OSPREY_earliest(
+          delay,
+          OSPREY_remaining(
+            _last_request_time,
+            OSPREY_ADDRESSING_TIMEOUT + 1,
+            now
+          )
+        );
+      if(_joining && (_state == OSPREY_SLAVE_CONNECTED))
+        delay = OSPREY_earliest(
+          delay,
+          OSPREY_remaining(_join_time, OSPREY_ADDRESSING_TIMEOUT + 1, now)
+        );
+      #if OSPREY_LEASE_TIME
+        if(_state == OSPREY_SLAVE_CONNECTED)
+          delay = OSPREY_earliest(
+            delay,
+            OSPREY_millis_delay(
+              OSPREY_remaining(
+                _lease_time,
+                OSPREY_LEASE_TIME / 2,
+                PJON_MILLIS()
+              )
+            )
+          );
+      #endif
+      return delay;
     };
 
   private:
-    OSPREY_Connected   _connected;
-    void               *_custom_pointer;
-    uint32_t           _last_request_time;
-    uint32_t           _rid = 0;
-    PJON_Error         _slave_error;
-    PJON_Receiver      _slave_receiver;
+    uint8_t             _action = 0;
+    uint32_t            _action_delay = 0;
+    uint32_t            _action_time = 0;
+    uint8_t             _attempts = 0;
+    uint8_t             _joining = 0;
+    uint32_t            _join_time = 0;
+    uint32_t            _last_request_time = 0;
+    #if OSPREY_LEASE_TIME
+      uint16_t          _lease_packet = PJON_MAX_PACKETS;
+      uint32_t          _lease_time = 0;
+    #endif
+    uint8_t             _master_configuration[ConfigurationLength];
+    uint32_t            _master_configuration_hash = 0;
+    uint16_t            _master_configuration_length = 0;
+    uint16_t            _packet = PJON_MAX_PACKETS;
+    uint8_t             _packet_request = 0;
+    uint32_t            _rid = 0;
+    uint8_t             _state = OSPREY_SLAVE_IDLE;
+    OSPREYStorage      *_storage = NULL;
+    uint16_t            _storage_address = 0;
+    #if OSPREY_TELEMETRY
+      OSPREY_Telemetry  _telemetry;
+    #endif
+
+    /* Random delay of the next OSPREY_ID_REQUEST, after consecutive failures
+       the window grows exponentially up to OSPREY_BACKOFF_MAX: */
+
+    uint32_t backoff() const {
+      if(!_attempts) return 0;
+      uint32_t window = OSPREY_BACKOFF_BASE;
+      for(uint8_t i = 1; (i < _attempts) && (window < OSPREY_BACKOFF_MAX); i++)
+        window *= 2;
+      if(window > OSPREY_BACKOFF_MAX) window = OSPREY_BACKOFF_MAX;
+      return (uint32_t)PJON_RANDOM(window) * 1000;
+    };
+
+    /* Set the id reserved by master, store its configuration and confirm: */
+
+    void assign(
+      uint8_t id,
+      const uint8_t *config,
+      uint16_t length,
+      bool hashed
+    ) {
+      this->set_id(id);
+      configure(config, length, hashed);
+      _joining = OSPREY_ID_CONFIRM;
+      schedule(OSPREY_ID_CONFIRM, 0);
+      set_state(OSPREY_SLAVE_CONFIRMING);
+    };
+
+    /* Cancel the scheduled or pending addressing request: */
+
+    void cancel() {
+      _action = 0;
+      if(_packet != PJON_MAX_PACKETS) PJON<Strategy>::remove(_packet);
+      _packet = PJON_MAX_PACKETS;
+    };
+
+    /* Store the configuration of master. If hashed it is preceded by its
+       hash, the stored one is kept if the hash did not change: */
+
+    void configure(const uint8_t *config, uint16_t length, bool hashed) {
+      if(hashed) {
+        if(
+          (length < 4) ||
+          (OSPREY_read_hash(config) == _master_configuration_hash)
+        ) return;
+        _master_configuration_hash = OSPREY_read_hash(config);
+        config += 4;
+        length -= 4;
+      }
+      _master_configuration_length =
+        (length < ConfigurationLength) ? length : ConfigurationLength;
+      memcpy(_master_configuration, config, _master_configuration_length);
+      if(!hashed)
+        _master_configuration_hash = OSPREY_configuration_hash(
+          _master_configuration,
+          _master_configuration_length
+        );
+    };
+
+    /* Dispatch the scheduled addressing request, OSPREY_ID_REQUEST includes
+       the hash of the configuration of master known if
+       OSPREY_CONFIGURATION_HASH is true: */
+
+    void dispatch() {
+      uint8_t request[5 + ConfigurationLength];
+      uint16_t length = 1;
+      request[0] = _action;
+      if((_action == OSPREY_ID_CONFIRM) || (_action == OSPREY_ID_REFRESH)) {
+        memcpy(request + 1, configuration, configuration_length);
+        length += configuration_length;
+      }
+      #if OSPREY_CONFIGURATION_HASH
+        if(_action == OSPREY_ID_REQUEST) {
+          OSPREY_write_hash(request + 1, _master_configuration_hash);
+          length += 4;
+        }
+      #endif
+      PJON_Packet_Info info;
+      info.rx.id = OSPREY_MASTER_ID;
+      PJONTools::copy_id(info.rx.bus_id, this->tx.bus_id, 4);
+      info.header = this->config | required_config;
+      info.port = OSPREY_DYNAMIC_ADDRESSING_PORT;
+      if(_packet != PJON_MAX_PACKETS) PJON<Strategy>::remove(_packet);
+      _packet = PJON<Strategy>::send(info, request, length);
+      if(_packet == PJON_FAIL) {
+        // Packet buffer full, try again after a random delay
+        _packet = PJON_MAX_PACKETS;
+        schedule(_action, (uint32_t)PJON_RANDOM(OSPREY_COLLISION_DELAY) * 1000);
+        return;
+      }
+      _packet_request = _action;
+      _last_request_time = PJON_MICROS();
+      _action = 0;
+    };
+
+    /* Handle the acknowledgement of an addressing request: */
+
+    void request_delivered(uint8_t request) {
+      #if OSPREY_LEASE_TIME
+        if(
+          (request == OSPREY_ID_CONFIRM) ||
+          (request == OSPREY_ID_REFRESH) ||
+          (request == OSPREY_ID_RENEW)
+        ) _lease_time = PJON_MILLIS();
+      #endif
+      if(request == OSPREY_ID_RENEW) OSPREY_TELEMETRY_COUNT(id_renew);
+      if(request == _joining) { // The master can negate it from now on
+        OSPREY_TELEMETRY_LATENCY(PJON_MICROS() - _join_time);
+        _join_time = PJON_MICROS();
+      }
+      if(request == OSPREY_ID_CONFIRM) {
+        OSPREY_TELEMETRY_COUNT(id_confirm);
+        save_identity();
+        set_state(OSPREY_SLAVE_CONNECTED);
+      }
+      if(request == OSPREY_ID_REFRESH) {
+        OSPREY_TELEMETRY_COUNT(id_refresh);
+        set_state(OSPREY_SLAVE_CONNECTED);
+      }
+      if(request == OSPREY_ID_NEGATE) {
+        this->set_id(PJON_NOT_ASSIGNED);
+        connected = false;
+        save_identity();
+        set_state(OSPREY_SLAVE_IDLE);
+      }
+    };
+
+    /* The master did not negate the id confirmed or restored within
+       OSPREY_ADDRESSING_TIMEOUT from its acknowledgement, the slave is
+       connected: */
+
+    void joined() {
+      _joining = 0;
+      _attempts = 0;
+      connected = true;
+      handlers.connected(
+        _master_configuration,
+        _master_configuration_length
+      );
+    };
+
+    /* Handle the failure of an addressing request, a failed or negated
+       OSPREY_ID_REQUEST or OSPREY_ID_CONFIRM, or the OSPREY_ID_REFRESH of a
+       rejoin, is followed by a new OSPREY_ID_REQUEST after the backoff. A
+       failed OSPREY_ID_RENEW is transmitted again until the lease expires: */
+
+    void request_failed(uint8_t request) {
+      if((request == OSPREY_ID_REFRESH) && (_joining != OSPREY_ID_REFRESH))
+        return set_state(OSPREY_SLAVE_CONNECTED);
+      _joining = 0;
+      if(request == OSPREY_ID_NEGATE) set_state(OSPREY_SLAVE_CONNECTED);
+      else if((request == OSPREY_ID_RENEW) && leased())
+        schedule(
+          OSPREY_ID_RENEW,
+          (uint32_t)PJON_RANDOM(OSPREY_COLLISION_DELAY) * 1000
+        );
+      else {
+        if(request != OSPREY_ID_REQUEST) this->set_id(PJON_NOT_ASSIGNED);
+        connected = false;
+        if(_attempts < 255) _attempts++;
+        schedule(OSPREY_ID_REQUEST, backoff());
+        set_state(OSPREY_SLAVE_REQUESTING);
+      }
+      OSPREY_TELEMETRY_COUNT(acquisition_fail);
+      handlers.error(OSPREY_ID_ACQUISITION_FAIL, request);
+    };
+
+    /* Check if the lease of the id is not expired (OSPREY_LEASE_TIME): */
+
+    bool leased() const {
+      #if OSPREY_LEASE_TIME
+        return (uint32_t)(PJON_MILLIS() - _lease_time) < OSPREY_LEASE_TIME;
+      #else
+        return true;
+      #endif
+    };
+
+    /* Restore the identity saved in storage, returns false if the storage
+       is not set or does not contain a valid identity: */
+
+    bool load_identity() {
+      uint8_t record[OSPREY_SLAVE_STORAGE_LENGTH];
+      if(
+        !_storage ||
+        !_storage->read(_storage_address, record, sizeof(record)) ||
+        (record[0] != OSPREY_STORAGE_VERSION)
+      ) return false;
+      uint16_t length = (record[12] << 8) | record[13];
+      if(
+        (length > ConfigurationLength) ||
+        !_storage->read(
+          _storage_address + sizeof(record),
+          _master_configuration,
+          length
+        )
+      ) return false;
+      PJONTools::copy_id(this->tx.mac, record + 1, 6);
+      PJONTools::copy_id(this->tx.bus_id, record + 7, 4);
+      this->set_id(record[11]);
+      _master_configuration_length = length;
+      _master_configuration_hash =
+        OSPREY_configuration_hash(_master_configuration, length);
+      return true;
+    };
+
+    /* Save the identity in storage:
+       VERSION - MAC - BUS ID - DEVICE ID - LENGTH - CONFIGURATION */
+
+    bool save_identity() {
+      if(!_storage) return false;
+      uint8_t record[OSPREY_SLAVE_STORAGE_LENGTH];
+      record[0] = OSPREY_STORAGE_VERSION;
+      PJONTools::copy_id(record + 1, this->tx.mac, 6);
+      PJONTools::copy_id(record + 7, this->tx.bus_id, 4);
+      record[11] = this->tx.id;
+      record[12] = (uint8_t)(_master_configuration_length >> 8);
+      record[13] = (uint8_t)_master_configuration_length;
+      return
+        _storage->write(_storage_address, record, sizeof(record)) &&
+        _storage->write(
+          _storage_address + sizeof(record),
+          _master_configuration,
+          _master_configuration_length
+        ) &&
+        _storage->flush();
+    };
+
+    /* Refresh the id restored from storage, if the master negates it a new
+       id is requested: */
+
+    void rejoin() {
+      _joining = OSPREY_ID_REFRESH;
+      _join_time = PJON_MICROS();
+      schedule(OSPREY_ID_REFRESH, 0);
+      set_state(OSPREY_SLAVE_REFRESHING);
+    };
+
+    /* Random delay of the response to a OSPREY_ID_LIST, the window is
+       proportional to the responses expected: advertised by the master or
+       else the ids of the page not known. Without a page the window is
+       OSPREY_COLLISION_DELAY:
+       OSPREY_ID_LIST - FIRST ID - IDS COUNT - BITMAP - EXPECTED RESPONSES */
+
+    static uint32_t response_delay(const uint8_t *request, uint16_t length) {
+      if(!paged(request, length))
+        return (uint32_t)PJON_RANDOM(OSPREY_COLLISION_DELAY) * 1000;
+      uint8_t bitmap = (request[2] + 7) / 8;
+      uint32_t expected = request[2];
+      if(length > (3 + bitmap)) expected = request[3 + bitmap];
+      else for(uint8_t i = 0; i < request[2]; i++)
+        if(request[3 + (i / 8)] & (1 << (i % 8))) expected--;
+      uint32_t window = expected * OSPREY_RESPONSE_SLOT;
+      if(window < OSPREY_RESPONSE_WINDOW_MIN)
+        window = OSPREY_RESPONSE_WINDOW_MIN;
+      if(window > OSPREY_RESPONSE_WINDOW_MAX)
+        window = OSPREY_RESPONSE_WINDOW_MAX;
+      return (uint32_t)PJON_RANDOM(window / 1000) * 1000;
+    };
+
+    /* Schedule an addressing request after a delay in microseconds: */
+
+    void schedule(uint8_t request, uint32_t delay) {
+      cancel();
+      _action = request;
+      _action_time = PJON_MICROS();
+      _action_delay = delay;
+    };
+
+    #if OSPREY_LEASE_TIME
+      /* Track the application packet sent if it is addressed to master,
+         includes the MAC address and requires the acknowledgement: the
+         master renews the lease when it receives it, so its
+         acknowledgement renews the lease as an OSPREY_ID_RENEW would. Only
+         the slot returned by send() is checked, one packet at a time is
+         tracked: */
+
+      uint16_t track_lease_packet(uint16_t packet) {
+        if(
+          (packet >= PJON_MAX_PACKETS) ||
+          (_lease_packet != PJON_MAX_PACKETS) ||
+          (_state != OSPREY_SLAVE_CONNECTED) ||
+          (PJON<Strategy>::packets[packet].content[0] != OSPREY_MASTER_ID)
+        ) return packet;
+        PJON_Packet_Info info;
+        PJON<Strategy>::parse(PJON<Strategy>::packets[packet].content, info);
+        if(
+          (info.header & (PJON_ACK_REQ_BIT | PJON_MAC_BIT)) ==
+          (PJON_ACK_REQ_BIT | PJON_MAC_BIT)
+        ) _lease_packet = packet;
+        return packet;
+      };
+    #endif
+
+    /* Set the addressing state and notify its change: */
+
+    void set_state(uint8_t state) {
+      if(_state == state) return;
+      _state = state;
+      handlers.state_change(state);
+    };
 };
@@ -0,0 +1,52 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "OSPREYDefines.h"
+
+/* Non-volatile memory where OSPREY saves its state.
+   The implementations available are in the storage directory:
+   - OSPREYFileStorage   POSIX file (Linux)
+   - OSPREYEEPROMStorage EEPROM (Arduino compatible microcontrollers) */
+
+class OSPREYStorage {
+  public:
+    virtual ~OSPREYStorage() {};
+
+    /* Commit the data written, OSPREY calls it once after each group of
+       writes (a device reference, the devices buffer or an identity): */
+
+    virtual bool flush() {
+      return true;
+    };
+
+    /* Read length bytes starting from address, returns false on failure: */
+
+    virtual bool read(uint16_t address, uint8_t *data, uint16_t length) = 0;
+
+    /* Write length bytes starting from address, returns false on failure: */
+
+    virtual bool write(
+      uint16_t address,
+      const uint8_t *data,
+      uint16_t length
+    ) = 0;
+};
@@ -0,0 +1,180 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+
+#pragma once
+#include "OSPREYMaster.h"
+
+/* OSPREYSubMaster is the master of a bus segment (it must have its own bus
+   id) which reports its devices buffer to a root master (OSPREYRootMaster)
+   in another bus. Each time its devices buffer changes, and at least every
+   OSPREY_DIRECTORY_TIME, it transmits its assigned ids to the root master
+   using a sequence of OSPREY_ID_DIRECTORY pages:
+   uint8_t segment_bus_id[] = {0, 0, 0, 2};
+   uint8_t root_bus_id[] = {0, 0, 0, 1};
+   OSPREYSubMaster<LocalUDP> sub_master(segment_bus_id);
+   sub_master.set_root(root_bus_id); */
+
+template<
+  typename Strategy,
+  uint8_t MaxSlaves = OSPREY_MAX_SLAVES,
+  uint16_t ConfigurationLength = OSPREY_CONFIGURATION_LENGTH,
+  typename Handlers = OSPREYMasterCallbacks
+>
+class OSPREYSubMaster :
+  public OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers> {
+  typedef OSPREYMaster<Strategy, MaxSlaves, ConfigurationLength, Handlers>
+    Master;
+
+  public:
+    OSPREYSubMaster(const uint8_t *bus) : Master(bus) {
+      set_default();
+    };
+
+    /* Sub-master error handler, if an OSPREY_ID_DIRECTORY page is lost all
+       the assigned ids are reported again: */
+
+    void error(uint8_t code, uint16_t data) {
+      if(
+        (code == PJON_CONNECTION_LOST) &&
+        (_directory_packet != PJON_MAX_PACKETS) &&
+        (data == _directory_packet)
+      ) {
+        _directory_packet = PJON_MAX_PACKETS;
+        _directory_next = 0;
+        _directory_lost = true;
+      }
+      Master::error(code, data);
+    };
+
+    static void static_error_handler(uint8_t code, uint16_t data, void *cp) {
+      ((OSPREYSubMaster *)cp)->error(code, data);
+    };
+
+    /* Set default configuration: */
+
+    void set_default() {
+      Master::set_default();
+      PJON<Strategy>::set_error(static_error_handler);
+    };
+
+    /* Set the bus id of the root master, the assigned ids are reported: */
+
+    void set_root(const uint8_t *bus_id) {
+      PJONTools::copy_id(_root_bus_id, bus_id, 4);
+      _root = true;
+      _directory_next = 0;
+      _directory_lost = true;
+    };
+
+    /* Sub-master packet handling update: */
+
+    uint8_t update() {
+      if(_root) update_directory();
+      return Master::update();
+    };
+
+    /* Delay until update() has timed work to do, the next page of the
+       directory report included: */
+
+    uint32_t update_delay() {
+      uint32_t delay = Master::update_delay();
+      if(
+        !_root || (
+          (_directory_packet != PJON_MAX_PACKETS) &&
+          PJON<Strategy>::packets[_directory_packet].state
+        )
+      ) return delay;
+      if(
+        _directory_next || _directory_lost ||
+        (_directory_version != this->version())
+      ) return 0;
+      return OSPREY_earliest(
+        delay,
+        OSPREY_remaining(_directory_time, OSPREY_DIRECTORY_TIME, PJON_MICROS())
+      );
+    };
+
+  private:
+    uint16_t _directory_packet = PJON_MAX_PACKETS;
+    bool     _directory_lost = false;
+    uint8_t  _directory_next = 0;
+    uint32_t _directory_time = 0;
+    uint16_t _directory_version = 0;
+    bool     _root = false;
+    uint8_t  _root_bus_id[4];
+
+    /* Transmit the OSPREY_ID_DIRECTORY page starting from _directory_next
+       to the root master, returns false if the packet buffer is full:
+       OSPREY_ID_DIRECTORY - FIRST ID - LAST ID - (MAC - DEVICE ID) * COUNT */
+
+    bool send_directory() {
+      uint8_t page[3 + (OSPREY_DIRECTORY_PAGE_LENGTH * 7)];
+      uint16_t length = 3;
+      uint8_t count = 0;
+      uint8_t id = _directory_next;
+      for(; id <= MaxSlaves; id++) {
+        if(this->get_state(id) != OSPREY_INDEX_ASSIGNED) continue;
+        if(count++ == OSPREY_DIRECTORY_PAGE_LENGTH) break;
+        PJONTools::copy_id(page + length, this->ids[id - 1].mac, 6);
+        page[length + 6] = id;
+        length += 7;
+      }
+      page[0] = OSPREY_ID_DIRECTORY;
+      page[1] = _directory_next;
+      page[2] = id - 1;
+      PJON_Packet_Info info;
+      info.rx.id = OSPREY_MASTER_ID;
+      PJONTools::copy_id(info.rx.bus_id, _root_bus_id, 4);
+      info.port = OSPREY_DYNAMIC_ADDRESSING_PORT;
+      info.header =
+        PJON<Strategy>::config | this->required_config | PJON_MODE_BIT;
+      uint16_t result = PJON<Strategy>::send(info, page, length);
+      if(result == PJON_FAIL) return false;
+      _directory_packet = result;
+      _directory_next = (id > MaxSlaves) ? 0 : id;
+      return true;
+    };
+
+    /* Transmit the next OSPREY_ID_DIRECTORY page when the previous one is
+       delivered, a new report starts if the assigned ids changed: */
+
+    void update_directory() {
+      if(
+        (_directory_packet != PJON_MAX_PACKETS) &&
+        PJON<Strategy>::packets[_directory_packet].state
+      ) return;
+      _directory_packet = PJON_MAX_PACKETS;
+      if(!_directory_next) {
+        uint32_t now = PJON_MICROS();
+        if(
+          !_directory_lost &&
+          (_directory_version == this->version()) &&
+          ((uint32_t)(now - _directory_time) < OSPREY_DIRECTORY_TIME)
+        ) return;
+        _directory_lost = false;
+        _directory_version = this->version();
+        _directory_time = now;
+        _directory_next = 1;
+      }
+      send_directory();
+    };
+};
@@ -0,0 +1,68 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "OSPREYDefines.h"
+
+/* Addressing telemetry, collected only if OSPREY_TELEMETRY is true.
+   Request counters count the addressing requests handled, join_latency is
+   an histogram of the time elapsed between the reservation of an id and its
+   confirmation (master) or between request_id() and the connection (slave),
+   bucket i counts latencies lower than 2^i milliseconds, the last bucket
+   counts all the others. */
+
+struct OSPREY_Telemetry {
+  uint32_t id_request = 0;
+  uint32_t id_confirm = 0;
+  uint32_t id_refresh = 0;
+  uint32_t id_negate = 0;
+  uint32_t id_list = 0;
+  uint32_t id_renew = 0;
+  uint32_t id_retry = 0;
+  uint32_t id_probe = 0;
+  uint32_t probes_lost = 0;
+  uint32_t reservations_expired = 0;
+  uint32_t leases_expired = 0;
+  uint32_t devices_buffer_full = 0;
+  uint32_t connection_lost = 0;
+  uint32_t acquisition_fail = 0;
+  uint32_t join_latency[OSPREY_TELEMETRY_BUCKETS] = {};
+
+  /* Add a latency in microseconds to the join latency histogram: */
+
+  void add_join_latency(uint32_t latency) {
+    uint32_t ms = latency / 1000;
+    uint8_t bucket = 0;
+    while(ms && (bucket < (OSPREY_TELEMETRY_BUCKETS - 1))) {
+      ms >>= 1;
+      bucket++;
+    }
+    join_latency[bucket]++;
+  };
+};
+
+#if OSPREY_TELEMETRY
+  #define OSPREY_TELEMETRY_COUNT(C) this->_telemetry.C++
+  #define OSPREY_TELEMETRY_LATENCY(L) this->_telemetry.add_join_latency(L)
+#else
+  #define OSPREY_TELEMETRY_COUNT(C) do {} while(0)
+  #define OSPREY_TELEMETRY_LATENCY(L) do {} while(0)
+#endif
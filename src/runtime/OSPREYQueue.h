@@ -0,0 +1,81 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+/* Bounded lock-free single producer single consumer queue. Elements are
+   written and read in place: the producer fills the element returned by
+   back() and publishes it calling push(), the consumer reads the element
+   returned by front() and releases it calling pop(). One element is kept
+   empty to distinguish a full queue from an empty one: */
+
+template<typename T, uint16_t Length>
+class OSPREYQueue {
+  public:
+    /* Get the next element to be written, NULL if the queue is full: */
+
+    T *back() {
+      uint16_t head = _head.load(std::memory_order_relaxed);
+      if(next(head) == _tail.load(std::memory_order_acquire)) return NULL;
+      return &_items[head];
+    };
+
+    /* Check if the queue is empty (consumer side): */
+
+    bool empty() const {
+      return
+        _tail.load(std::memory_order_relaxed) ==
+        _head.load(std::memory_order_acquire);
+    };
+
+    /* Get the next element to be read, NULL if the queue is empty: */
+
+    T *front() {
+      uint16_t tail = _tail.load(std::memory_order_relaxed);
+      if(tail == _head.load(std::memory_order_acquire)) return NULL;
+      return &_items[tail];
+    };
+
+    /* Release the element returned by front(): */
+
+    void pop() {
+      uint16_t tail = _tail.load(std::memory_order_relaxed);
+      _tail.store(next(tail), std::memory_order_release);
+    };
+
+    /* Publish the element returned by back(): */
+
+    void push() {
+      uint16_t head = _head.load(std::memory_order_relaxed);
+      _head.store(next(head), std::memory_order_release);
+    };
+
+  private:
+    T                     _items[Length];
+    std::atomic<uint16_t> _head{0};
+    std::atomic<uint16_t> _tail{0};
+
+    static uint16_t next(uint16_t index) {
+      return (index + 1 < Length) ? index + 1 : 0;
+    };
+};
@@ -0,0 +1,270 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "../OSPREYMaster.h"
+#include "OSPREYQueue.h"
+#include "OSPREYWait.h"
+#include <sys/eventfd.h>
+#include <thread>
+
+// Length of the events and outbound packets queues
+#ifndef OSPREY_RUNTIME_QUEUE_LENGTH
+  #define OSPREY_RUNTIME_QUEUE_LENGTH    32
+#endif
+
+// Maximum time in microseconds spent receiving in each runtime cycle
+#ifndef OSPREY_RUNTIME_RECEIVE_TIME
+  #define OSPREY_RUNTIME_RECEIVE_TIME  1000
+#endif
+
+// Events types
+#define OSPREY_EVENT_PACKET               0
+#define OSPREY_EVENT_FOUND_SLAVE          1
+#define OSPREY_EVENT_ERROR                2
+
+/* Event delivered by OSPREYThreadedMaster to the application:
+   OSPREY_EVENT_PACKET      - info, payload and length of a packet received
+   OSPREY_EVENT_FOUND_SLAVE - info.tx is the slave, payload and length its
+                              configuration
+   OSPREY_EVENT_ERROR       - code and data of the error */
+
+struct OSPREY_Event {
+  uint8_t          type = OSPREY_EVENT_PACKET;
+  PJON_Packet_Info info;
+  uint8_t          code = 0;
+  uint16_t         data = 0;
+  uint16_t         length = 0;
+  uint8_t          payload[PJON_PACKET_MAX_LENGTH];
+};
+
+/* Packet queued by the application, sent by OSPREYThreadedMaster: */
+
+struct OSPREY_Outbound {
+  PJON_Packet_Info info;
+  uint16_t         length = 0;
+  uint8_t          payload[PJON_PACKET_MAX_LENGTH];
+};
+
+/* OSPREYMaster handlers policy required by OSPREYThreadedMaster, each call
+   is queued as an OSPREY_Event, if the queue is full the event is dropped
+   and counted. Addressing packets are handled by the master and not queued:
+   OSPREYMaster<LocalUDP, 25, 0, OSPREYQueueHandlers<>> master; */
+
+template<uint16_t Length = OSPREY_RUNTIME_QUEUE_LENGTH>
+struct OSPREYQueueHandlers {
+  OSPREYQueue<OSPREY_Event, Length> events;
+  std::atomic<uint32_t>             dropped{0};
+
+  void error(uint8_t code, uint16_t data) {
+    OSPREY_Event *event = queue(OSPREY_EVENT_ERROR, NULL, 0);
+    if(!event) return;
+    event->code = code;
+    event->data = data;
+    events.push();
+  };
+
+  void found_slave(
+    const PJON_Endpoint &endpoint,
+    const uint8_t *configuration,
+    uint16_t length
+  ) {
+    OSPREY_Event *event =
+      queue(OSPREY_EVENT_FOUND_SLAVE, configuration, length);
+    if(!event) return;
+    event->info.tx = endpoint;
+    events.push();
+  };
+
+  void receiver(
+    uint8_t *payload,
+    uint16_t length,
+    const PJON_Packet_Info &info
+  ) {
+    if(info.port == OSPREY_DYNAMIC_ADDRESSING_PORT) return;
+    OSPREY_Event *event = queue(OSPREY_EVENT_PACKET, payload, length);
+    if(!event) return;
+    event->info = info;
+    events.push();
+  };
+
+  /* Fill the next event, NULL if the queue is full: */
+
+  OSPREY_Event *queue(uint8_t type, const uint8_t *payload, uint16_t length) {
+    OSPREY_Event *event = events.back();
+    if(!event) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return NULL;
+    }
+    if(length > PJON_PACKET_MAX_LENGTH) length = PJON_PACKET_MAX_LENGTH;
+    event->type = type;
+    event->length = length;
+    if(length) memcpy(event->payload, payload, length);
+    return event;
+  };
+};
+
+/* Runs the master's receive, update and addressing on a dedicated thread,
+   the application receives OSPREY_Event through a lock-free queue and sends
+   packets through another one. After start() the master must be accessed
+   only by the runtime's thread:
+   OSPREYMaster<LocalUDP, 25, 0, OSPREYQueueHandlers<>> master;
+   OSPREYThreadedMaster<decltype(master)> runtime(master); */
+
+template<typename Master, uint16_t Length = OSPREY_RUNTIME_QUEUE_LENGTH>
+class OSPREYThreadedMaster {
+  public:
+    Master &master;
+
+    OSPREYThreadedMaster(
+      Master &m,
+      uint32_t receive_time = OSPREY_RUNTIME_RECEIVE_TIME
+    ) : master(m), _receive_time(receive_time) { };
+
+    ~OSPREYThreadedMaster() {
+      stop();
+    };
+
+    /* Count the events dropped because the events queue was full: */
+
+    uint32_t dropped() const {
+      return master.handlers.dropped.load(std::memory_order_relaxed);
+    };
+
+    /* Get the next event, NULL if none, release it calling release(): */
+
+    OSPREY_Event *receive() {
+      return master.handlers.events.front();
+    };
+
+    /* Release the event returned by receive(): */
+
+    void release() {
+      master.handlers.events.pop();
+    };
+
+    /* Queue a packet to be sent, returns false if the outbound queue is
+       full. If header is PJON_NO_HEADER the master's configuration is used: */
+
+    bool send(
+      uint8_t id,
+      const uint8_t *bus_id,
+      const void *payload,
+      uint16_t length,
+      uint8_t header = PJON_NO_HEADER,
+      uint16_t port = PJON_BROADCAST
+    ) {
+      PJON_Packet_Info info;
+      info.rx.id = id;
+      PJONTools::copy_id(info.rx.bus_id, bus_id, 4);
+      info.header = header;
+      info.port = port;
+      return send(info, payload, length);
+    };
+
+    bool send(
+      const PJON_Packet_Info &info,
+      const void *payload,
+      uint16_t length
+    ) {
+      OSPREY_Outbound *packet = _outbound.back();
+      if(!packet || (length > PJON_PACKET_MAX_LENGTH)) return false;
+      packet->info = info;
+      packet->length = length;
+      memcpy(packet->payload, payload, length);
+      _outbound.push();
+      wake();
+      return true;
+    };
+
+    /* Set the readiness file descriptor of the master's strategy (for
+       example the socket of a UDP strategy), the runtime's thread sleeps on
+       it until a packet is received, a packet is queued or update_delay()
+       elapses instead of receiving continuously. Call it before start(): */
+
+    void set_fd(int fd) {
+      _fd = fd;
+    };
+
+    /* Begin the master and start the runtime's thread: */
+
+    void start() {
+      if(_running.load(std::memory_order_acquire)) return;
+      master.begin();
+      if((_fd >= 0) && (_wake_fd < 0)) _wake_fd = eventfd(0, EFD_NONBLOCK);
+      _running.store(true, std::memory_order_release);
+      _thread = std::thread(&OSPREYThreadedMaster::run, this);
+    };
+
+    /* Stop the runtime's thread, after it the master can be accessed: */
+
+    void stop() {
+      if(!_running.load(std::memory_order_acquire)) return;
+      _running.store(false, std::memory_order_release);
+      wake();
+      _thread.join();
+      if(_wake_fd >= 0) close(_wake_fd);
+      _wake_fd = -1;
+    };
+
+  private:
+    OSPREYQueue<OSPREY_Outbound, Length> _outbound;
+    int                                  _fd = -1;
+    uint32_t                             _receive_time;
+    std::atomic<bool>                    _running{false};
+    std::thread                          _thread;
+    int                                  _wake_fd = -1;
+
+    /* Check if the master's packets buffer is full: */
+
+    bool packets_full() const {
+      for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++)
+        if(!master.packets[i].state) return false;
+      return true;
+    };
+
+    /* Runtime's thread, queued packets are moved in the master's packets
+       buffer while it has space, a packet refused by the master (it reports
+       the error) is discarded: */
+
+    void run() {
+      while(_running.load(std::memory_order_acquire)) {
+        for(OSPREY_Outbound *p = _outbound.front(); p; p = _outbound.front()) {
+          if(p->info.header == PJON_NO_HEADER) p->info.header = master.config;
+          if(packets_full()) break;
+          master.send(p->info, p->payload, p->length);
+          _outbound.pop();
+        }
+        master.update();
+        if(_wake_fd < 0) master.receive(_receive_time);
+        else OSPREY_receive_wait(master, _fd, OSPREY_NO_DEADLINE, _wake_fd);
+      }
+    };
+
+    /* Wake the runtime's thread if it is waiting on the file descriptor: */
+
+    void wake() {
+      if(_wake_fd < 0) return;
+      uint64_t value = 1;
+      ssize_t written = write(_wake_fd, &value, sizeof(value));
+      (void)written;
+    };
+};
@@ -0,0 +1,75 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "../OSPREYDeadline.h"
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* Convert a delay in microseconds in a poll timeout in milliseconds, it is
+   rounded up so the deadline is elapsed when poll returns: */
+
+static inline int OSPREY_poll_timeout(uint32_t delay) {
+  if(delay == OSPREY_NO_DEADLINE) return -1;
+  uint32_t timeout = (delay / 1000) + ((delay % 1000) ? 1 : 0);
+  return (timeout > INT_MAX) ? INT_MAX : (int)timeout;
+};
+
+/* Receive on a Linux bus sleeping on the readiness file descriptor of its
+   strategy (for example the socket of a UDP strategy) instead of calling
+   receive() continuously. It returns PJON_ACK when a packet is received,
+   or PJON_FAIL when duration elapses or when update() is due according to
+   update_delay(). If wake_fd is passed (for example an eventfd written by
+   another thread) the wait ends when it is readable and it is drained:
+   for(;;) {
+     master.update();
+     OSPREY_receive_wait(master, fd, 1000000);
+   } */
+
+template<typename Bus>
+uint16_t OSPREY_receive_wait(
+  Bus &bus,
+  int fd,
+  uint32_t duration,
+  int wake_fd = -1
+) {
+  uint32_t time = PJON_MICROS();
+  for(;;) {
+    if(bus.receive() == PJON_ACK) return PJON_ACK;
+    uint32_t delay = OSPREY_earliest(
+      OSPREY_remaining(time, duration, PJON_MICROS()),
+      bus.update_delay()
+    );
+    if(!delay) return PJON_FAIL;
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+    int result =
+      poll(fds, (wake_fd < 0) ? 1 : 2, OSPREY_poll_timeout(delay));
+    if((result < 0) && (errno != EINTR)) return PJON_FAIL;
+    if((result > 0) && (wake_fd >= 0) && (fds[1].revents & POLLIN)) {
+      uint64_t value;
+      ssize_t drained = read(wake_fd, &value, sizeof(value));
+      (void)drained;
+      return PJON_FAIL;
+    }
+  }
+};
@@ -0,0 +1,62 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "../OSPREYStorage.h"
+#include <EEPROM.h>
+
+/* OSPREYStorage implementation using the EEPROM library, on ESP8266 and
+   ESP32 EEPROM.begin(size) must be called before using it, the flash sector
+   emulating the EEPROM is committed once by flush() after each group of
+   writes:
+   OSPREYEEPROMStorage storage; */
+
+class OSPREYEEPROMStorage : public OSPREYStorage {
+  public:
+    /* Commit the bytes written (ESP8266 and ESP32): */
+
+    bool flush() {
+      #if defined(ESP8266) || defined(ESP32)
+        return EEPROM.commit();
+      #else
+        return true;
+      #endif
+    };
+
+    /* Read length bytes starting from address: */
+
+    bool read(uint16_t address, uint8_t *data, uint16_t length) {
+      if(((uint32_t)address + length) > EEPROM.length()) return false;
+      for(uint16_t i = 0; i < length; i++) data[i] = EEPROM.read(address + i);
+      return true;
+    };
+
+    /* Write length bytes starting from address, only the bytes that differ
+       are written to reduce wear: */
+
+    bool write(uint16_t address, const uint8_t *data, uint16_t length) {
+      if(((uint32_t)address + length) > EEPROM.length()) return false;
+      for(uint16_t i = 0; i < length; i++)
+        if(EEPROM.read(address + i) != data[i])
+          EEPROM.write(address + i, data[i]);
+      return true;
+    };
+};
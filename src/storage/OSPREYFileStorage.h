@@ -0,0 +1,67 @@
+
+          /*\   __   __   __   __   __
+          shs- |  | |__  |__| |__| |__  \ /
+         dM_d: |__|  __| |    |  \ |__   |  0.1
+        dL:KM  Configuration-less, plug-and-play dynamic networking over PJON.
+       dM56Mh  EXPERIMENTAL, USE AT YOUR OWN RISK
+      yM87MM:
+       NM*(Mm          /|  Copyright (c) 2014-2020
+   ___yM(U*MMo        /j|  Giovanni Blu Mitolo All rights reserved.
+ _/OF/sMQWewrMNhfmmNNMN:|  Licensed under the Apache License, Version 2.0
+|\_\+sMM":{rMNddmmNNMN:_|  You may obtain a copy of the License at
+       yMMMMso         \|  http://www.apache.org/licenses/LICENSE-2.0
+       gtMfgm
+      mMA@Mf   Thanks to the support, expertise, kindness and talent of the
+      MMp';M   following contributors, the documentation, specification and
+      ysM1MM:  implementation have been tested, enhanced and verified:
+       sMM3Mh  Fred Larsen, Jeff Gueldre
+        dM6MN
+         dMtd:
+          \*/
+
+#pragma once
+#include "../OSPREYStorage.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+/* OSPREYStorage implementation using a POSIX file:
+   OSPREYFileStorage storage("/var/lib/osprey/roster"); */
+
+class OSPREYFileStorage : public OSPREYStorage {
+  public:
+    OSPREYFileStorage(const char *path) {
+      _file = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    };
+
+    // The file is closed by the destructor, copies would close it twice
+    OSPREYFileStorage(const OSPREYFileStorage &) = delete;
+    OSPREYFileStorage &operator=(const OSPREYFileStorage &) = delete;
+
+    ~OSPREYFileStorage() {
+      if(_file >= 0) close(_file);
+    };
+
+    /* Commit the data written to the device: */
+
+    bool flush() {
+      if(_file < 0) return false;
+      return fdatasync(_file) == 0;
+    };
+
+    /* Read length bytes starting from address: */
+
+    bool read(uint16_t address, uint8_t *data, uint16_t length) {
+      if(_file < 0) return false;
+      return pread(_file, data, length, address) == (ssize_t)length;
+    };
+
+    /* Write length bytes starting from address: */
+
+    bool write(uint16_t address, const uint8_t *data, uint16_t length) {
+      if(_file < 0) return false;
+      return pwrite(_file, data, length, address) == (ssize_t)length;
+    };
+
+  private:
+    int _file;
+};